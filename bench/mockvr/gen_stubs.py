@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# gen_stubs.py: generates do-nothing overrides for every pure virtual in the OpenVR interfaces
+# the mock runtime implements, so mockvr.cpp only has to override the calls vrdio actually makes
+# and keeps compiling when the OpenVR submodule gains new methods.
+#
+# usage: gen_stubs.py <openvr.h> <output header>
+
+import re
+import sys
+
+INTERFACES = ["IVRSystem", "IVRApplications", "IVRCompositor", "IVROverlay"]
+
+METHOD = re.compile(r"virtual\s+(.+?)\s*\b(\w+)\s*\((.*)\)\s*(const)?\s*=\s*0$", re.DOTALL)
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.DOTALL)
+    return re.sub(r"//[^\n]*", "", text)
+
+
+def class_body(text, name):
+    match = re.search(r"\bclass\s+" + name + r"\s*\{", text)
+    if not match:
+        sys.exit("gen_stubs.py: could not find class " + name)
+
+    depth = 1
+    pos = match.end()
+    while depth:
+        if text[pos] == "{":
+            depth += 1
+        elif text[pos] == "}":
+            depth -= 1
+        pos += 1
+    return text[match.end() : pos - 1]
+
+
+def stubs(body):
+    for statement in body.split(";"):
+        statement = " ".join(statement.split())
+        match = METHOD.search(statement)
+        if not match:
+            continue
+        ret, name, params, const = match.groups()
+        qualifier = " const" if const else ""
+        impl = "{}" if ret == "void" else "{ return {}; }"
+        yield "\t%s %s(%s)%s override %s" % (ret, name, params.strip(), qualifier, impl)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_stubs.py <openvr.h> <output header>")
+
+    with open(sys.argv[1]) as f:
+        text = strip_comments(f.read())
+
+    out = [
+        "// generated by gen_stubs.py from openvr.h - do not edit",
+        "#ifndef OPENVR_STUBS_H",
+        "#define OPENVR_STUBS_H",
+        "",
+        '#include "openvr.h"',
+        "",
+        "namespace mockvr {",
+        "using namespace vr;",
+        "",
+    ]
+    for name in INTERFACES:
+        out.append("class Stub%s : public %s {" % (name, name))
+        out.append("  public:")
+        out.extend(stubs(class_body(text, name)))
+        out.append("};")
+        out.append("")
+    out.append("} // namespace mockvr")
+    out.append("")
+    out.append("#endif // OPENVR_STUBS_H")
+
+    with open(sys.argv[2], "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,284 @@
+#include "mockvr.h"
+
+#include "openvr.h"
+#include "openvr_stubs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+// mockvr.cpp: just enough of an OpenVR runtime for vrdio to start, render and receive input.
+// everything vrdio doesn't call falls through to the generated stubs in openvr_stubs.h
+
+using namespace vr;
+
+namespace {
+// extensions requested from Qt and the device. lavapipe supports all of them, and they're a
+// subset of what SteamVR actually asks for
+constexpr const char* instanceExtensions =
+		"VK_KHR_external_memory_capabilities VK_KHR_get_physical_device_properties2";
+constexpr const char* deviceExtensions =
+		"VK_KHR_external_memory VK_KHR_dedicated_allocation VK_KHR_get_memory_requirements2";
+
+struct State {
+	std::mutex lock;
+	std::deque<VREvent_t> systemEvents;
+	std::map<VROverlayHandle_t, std::deque<VREvent_t>> overlayEvents;
+	std::map<VROverlayHandle_t, bool> visible;
+	VROverlayHandle_t nextHandle = mockvr::thumbnailHandle + 1;
+	uint32_t initToken = 0;
+	mockvr::Counters counters;
+};
+
+State& state() {
+	static State s;
+	return s;
+}
+
+int64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch())
+			.count();
+}
+
+// copies an extension list the way the real runtime does: returns the required size including
+// the null terminator, and only fills the buffer if it's big enough
+uint32_t copyString(const char* str, char* buf, uint32_t size) {
+	uint32_t needed = strlen(str) + 1;
+	if (buf && size >= needed)
+		memcpy(buf, str, needed);
+	return needed;
+}
+
+bool popEvent(std::deque<VREvent_t>& queue, VREvent_t* event, uint32_t size) {
+	if (queue.empty())
+		return false;
+	memcpy(event, &queue.front(), std::min<size_t>(size, sizeof(VREvent_t)));
+	queue.pop_front();
+	return true;
+}
+
+class MockSystem : public mockvr::StubIVRSystem {
+  public:
+	bool PollNextEvent(VREvent_t* pEvent, uint32_t uncbVREvent) override {
+		std::lock_guard<std::mutex> g(state().lock);
+		return popEvent(state().systemEvents, pEvent, uncbVREvent);
+	}
+	void AcknowledgeQuit_Exiting() override {}
+};
+
+class MockApplications : public mockvr::StubIVRApplications {
+  public:
+	// claim the manifest is installed, so vrdio doesn't try to write one
+	bool IsApplicationInstalled(const char*) override { return true; }
+	EVRApplicationError AddApplicationManifest(const char*, bool) override {
+		return VRApplicationError_None;
+	}
+	EVRApplicationError RemoveApplicationManifest(const char*) override {
+		return VRApplicationError_None;
+	}
+	EVRApplicationError SetApplicationAutoLaunch(const char*, bool) override {
+		return VRApplicationError_None;
+	}
+	const char* GetApplicationsErrorNameFromEnum(EVRApplicationError) override {
+		return "VRApplicationError_Mock";
+	}
+};
+
+class MockCompositor : public mockvr::StubIVRCompositor {
+  public:
+	uint32_t GetVulkanInstanceExtensionsRequired(char* pchValue, uint32_t unBufferSize) override {
+		return copyString(instanceExtensions, pchValue, unBufferSize);
+	}
+	uint32_t GetVulkanDeviceExtensionsRequired(
+			VkPhysicalDevice_T*, char* pchValue, uint32_t unBufferSize) override {
+		return copyString(deviceExtensions, pchValue, unBufferSize);
+	}
+};
+
+class MockOverlay : public mockvr::StubIVROverlay {
+  public:
+	EVROverlayError CreateDashboardOverlay(const char*, const char*,
+			VROverlayHandle_t* pMainHandle, VROverlayHandle_t* pThumbnailHandle) override {
+		std::lock_guard<std::mutex> g(state().lock);
+		*pMainHandle = mockvr::dashboardHandle;
+		*pThumbnailHandle = mockvr::thumbnailHandle;
+		// benchmarks want to see frames, so pretend the dashboard is open
+		state().visible.emplace(mockvr::dashboardHandle, true);
+		return VROverlayError_None;
+	}
+	EVROverlayError CreateOverlay(
+			const char*, const char*, VROverlayHandle_t* pOverlayHandle) override {
+		std::lock_guard<std::mutex> g(state().lock);
+		*pOverlayHandle = state().nextHandle++;
+		return VROverlayError_None;
+	}
+	EVROverlayError SetOverlayWidthInMeters(VROverlayHandle_t, float) override {
+		return VROverlayError_None;
+	}
+	EVROverlayError SetOverlayInputMethod(VROverlayHandle_t, VROverlayInputMethod) override {
+		return VROverlayError_None;
+	}
+	EVROverlayError SetOverlayMouseScale(VROverlayHandle_t, const HmdVector2_t*) override {
+		return VROverlayError_None;
+	}
+	EVROverlayError SetOverlayFlag(VROverlayHandle_t, VROverlayFlags, bool) override {
+		return VROverlayError_None;
+	}
+	EVROverlayError SetOverlayFromFile(VROverlayHandle_t, const char*) override {
+		return VROverlayError_None;
+	}
+	EVROverlayError SetOverlayTexture(
+			VROverlayHandle_t ulOverlayHandle, const Texture_t* pTexture) override {
+		if (!pTexture || !pTexture->handle)
+			return VROverlayError_InvalidTexture;
+
+		auto data = static_cast<const VRVulkanTextureData_t*>(pTexture->handle);
+		std::lock_guard<std::mutex> g(state().lock);
+		state().counters.textureSubmits++;
+		state().counters.lastSubmitNs = nowNs();
+		state().counters.lastTextureWidth = data->m_nWidth;
+		state().counters.lastTextureHeight = data->m_nHeight;
+		return VROverlayError_None;
+	}
+	bool IsOverlayVisible(VROverlayHandle_t ulOverlayHandle) override {
+		std::lock_guard<std::mutex> g(state().lock);
+		auto it = state().visible.find(ulOverlayHandle);
+		return it != state().visible.end() && it->second;
+	}
+	EVROverlayError ShowOverlay(VROverlayHandle_t ulOverlayHandle) override {
+		mockvr::setOverlayVisible(ulOverlayHandle, true);
+		return VROverlayError_None;
+	}
+	EVROverlayError HideOverlay(VROverlayHandle_t ulOverlayHandle) override {
+		mockvr::setOverlayVisible(ulOverlayHandle, false);
+		return VROverlayError_None;
+	}
+	bool PollNextOverlayEvent(
+			VROverlayHandle_t ulOverlayHandle, VREvent_t* pEvent, uint32_t uncbVREvent) override {
+		std::lock_guard<std::mutex> g(state().lock);
+		bool polled = popEvent(state().overlayEvents[ulOverlayHandle], pEvent, uncbVREvent);
+		if (polled)
+			state().counters.overlayEventsPolled++;
+		return polled;
+	}
+};
+
+MockSystem mockSystem;
+MockApplications mockApplications;
+MockCompositor mockCompositor;
+MockOverlay mockOverlay;
+} // namespace
+
+/* control surface */
+
+void mockvr::pushOverlayEvent(VROverlayHandle_t overlay, const VREvent_t& event) {
+	std::lock_guard<std::mutex> g(state().lock);
+	state().overlayEvents[overlay].push_back(event);
+}
+
+void mockvr::pushSystemEvent(const VREvent_t& event) {
+	std::lock_guard<std::mutex> g(state().lock);
+	state().systemEvents.push_back(event);
+}
+
+void mockvr::pushMouse(VROverlayHandle_t overlay, uint32_t eventType, float x, float y) {
+	VREvent_t event{};
+	event.eventType = eventType;
+	event.data.mouse.x = x;
+	event.data.mouse.y = y;
+	event.data.mouse.button = VRMouseButton_Left;
+	pushOverlayEvent(overlay, event);
+}
+
+void mockvr::pushScroll(VROverlayHandle_t overlay, float ydelta) {
+	VREvent_t event{};
+	event.eventType = VREvent_ScrollDiscrete;
+	event.data.scroll.ydelta = ydelta;
+	pushOverlayEvent(overlay, event);
+}
+
+void mockvr::setOverlayVisible(VROverlayHandle_t overlay, bool visible) {
+	VREvent_t event{};
+	event.eventType = visible ? VREvent_OverlayShown : VREvent_OverlayHidden;
+
+	std::lock_guard<std::mutex> g(state().lock);
+	state().visible[overlay] = visible;
+	state().overlayEvents[overlay].push_back(event);
+}
+
+mockvr::Counters mockvr::counters() {
+	std::lock_guard<std::mutex> g(state().lock);
+	return state().counters;
+}
+
+void mockvr::resetCounters() {
+	std::lock_guard<std::mutex> g(state().lock);
+	state().counters = {};
+}
+
+/* openvr_api entry points, as declared in openvr.h */
+
+namespace vr {
+uint32_t VR_CALLTYPE VR_InitInternal2(
+		EVRInitError* peError, EVRApplicationType, const char*) {
+	std::lock_guard<std::mutex> g(state().lock);
+	if (peError)
+		*peError = VRInitError_None;
+	return ++state().initToken;
+}
+
+uint32_t VR_CALLTYPE VR_InitInternal(EVRInitError* peError, EVRApplicationType eApplicationType) {
+	return VR_InitInternal2(peError, eApplicationType, nullptr);
+}
+
+void VR_CALLTYPE VR_ShutdownInternal() {}
+
+bool VR_CALLTYPE VR_IsHmdPresent() { return true; }
+
+bool VR_CALLTYPE VR_IsRuntimeInstalled() { return true; }
+
+bool VR_GetRuntimePath(char* pchPathBuffer, uint32_t unBufferSize, uint32_t* punRequiredBufferSize) {
+	uint32_t needed = copyString("/nonexistent/mockvr", pchPathBuffer, unBufferSize);
+	if (punRequiredBufferSize)
+		*punRequiredBufferSize = needed;
+	return unBufferSize >= needed;
+}
+
+void* VR_CALLTYPE VR_GetGenericInterface(const char* pchInterfaceVersion, EVRInitError* peError) {
+	void* iface = nullptr;
+	if (!strcmp(pchInterfaceVersion, IVRSystem_Version))
+		iface = static_cast<IVRSystem*>(&mockSystem);
+	else if (!strcmp(pchInterfaceVersion, IVRApplications_Version))
+		iface = static_cast<IVRApplications*>(&mockApplications);
+	else if (!strcmp(pchInterfaceVersion, IVRCompositor_Version))
+		iface = static_cast<IVRCompositor*>(&mockCompositor);
+	else if (!strcmp(pchInterfaceVersion, IVROverlay_Version))
+		iface = static_cast<IVROverlay*>(&mockOverlay);
+
+	if (peError)
+		*peError = iface ? VRInitError_None : VRInitError_Init_InterfaceNotFound;
+	return iface;
+}
+
+bool VR_CALLTYPE VR_IsInterfaceVersionValid(const char* pchInterfaceVersion) {
+	EVRInitError err;
+	return VR_GetGenericInterface(pchInterfaceVersion, &err) != nullptr;
+}
+
+const char* VR_CALLTYPE VR_GetVRInitErrorAsSymbol(EVRInitError error) {
+	return error == VRInitError_None ? "VRInitError_None" : "VRInitError_Mock";
+}
+
+const char* VR_CALLTYPE VR_GetVRInitErrorAsEnglishDescription(EVRInitError error) {
+	return error == VRInitError_None ? "No error" : "Interface not provided by mockvr";
+}
+
+uint32_t VR_CALLTYPE VR_GetInitToken() {
+	std::lock_guard<std::mutex> g(state().lock);
+	return state().initToken;
+}
+} // namespace vr
@@ -0,0 +1,37 @@
+#ifndef MOCKVR_H
+#define MOCKVR_H
+
+#include "openvr.h"
+
+#include <cstdint>
+// mockvr.h: control surface of the stand-in openvr_api library. benchmarks use this to script
+// input and to see what the "runtime" was handed, without a live SteamVR
+
+namespace mockvr {
+// handles given out by CreateDashboardOverlay
+inline constexpr vr::VROverlayHandle_t dashboardHandle = 1;
+inline constexpr vr::VROverlayHandle_t thumbnailHandle = 2;
+
+// queue events returned by IVROverlay::PollNextOverlayEvent / IVRSystem::PollNextEvent
+void pushOverlayEvent(vr::VROverlayHandle_t overlay, const vr::VREvent_t& event);
+void pushSystemEvent(const vr::VREvent_t& event);
+
+// helpers for the input events vrdio handles. coordinates are in overlay mouse space, with
+// (0,0) at the bottom left like SteamVR
+void pushMouse(vr::VROverlayHandle_t overlay, uint32_t eventType, float x, float y);
+void pushScroll(vr::VROverlayHandle_t overlay, float ydelta);
+
+void setOverlayVisible(vr::VROverlayHandle_t overlay, bool visible);
+
+struct Counters {
+	uint64_t textureSubmits = 0;
+	uint64_t overlayEventsPolled = 0;
+	int64_t lastSubmitNs = 0; // steady clock time of the last SetOverlayTexture
+	uint32_t lastTextureWidth = 0;
+	uint32_t lastTextureHeight = 0;
+};
+Counters counters();
+void resetCounters();
+} // namespace mockvr
+
+#endif // MOCKVR_H
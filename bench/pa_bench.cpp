@@ -0,0 +1,243 @@
+#include "pamanager.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFuture>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+// pa_bench.cpp: measures how PAManager scales with the number of sinks, against a private
+// PulseAudio server loaded with N null sinks. prints one JSON object per N
+
+namespace {
+// a throwaway pulseaudio instance that only listens on its own socket
+class PrivateServer {
+  public:
+	PrivateServer(const QString& binary, int sinks) {
+		if (!dir.isValid())
+			throw std::runtime_error("Could not create a temporary directory");
+
+		QFile script(dir.filePath("bench.pa"));
+		if (!script.open(QFile::WriteOnly))
+			throw std::runtime_error("Could not write the server script");
+		QTextStream out(&script);
+		out << "load-module module-native-protocol-unix auth-anonymous=1 socket="
+			<< socketPath() << '\n';
+		for (int i = 0; i < sinks; i++) {
+			out << "load-module module-null-sink sink_name=bench_" << i
+				<< " sink_properties=device.description=Bench_Sink_" << i << '\n';
+		}
+		script.close();
+
+		// keep it away from the user's runtime and state directories
+		QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+		env.insert("HOME", dir.path());
+		env.insert("XDG_RUNTIME_DIR", dir.path());
+		env.insert("XDG_CONFIG_HOME", dir.path());
+		env.insert("PULSE_RUNTIME_PATH", dir.path());
+		env.insert("PULSE_STATE_PATH", dir.path());
+		server.setProcessEnvironment(env);
+		server.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+		server.start(binary, {"-n", "--daemonize=no", "--exit-idle-time=-1", "--use-pid-file=no",
+									 "--disallow-exit", "--log-level=error", "-F", script.fileName()});
+		if (!server.waitForStarted())
+			throw std::runtime_error("Could not start " + binary.toStdString());
+
+		// loading hundreds of modules takes a moment
+		QElapsedTimer timeout;
+		timeout.start();
+		while (!QFile::exists(socketPath())) {
+			if (timeout.elapsed() > 30000 || server.state() != QProcess::Running)
+				throw std::runtime_error("Server did not come up");
+			QThread::msleep(10);
+		}
+	}
+
+	~PrivateServer() {
+		server.terminate();
+		if (!server.waitForFinished(5000))
+			server.kill();
+	}
+
+	QString socketPath() const { return dir.filePath("native"); }
+
+  private:
+	QTemporaryDir dir;
+	QProcess server;
+};
+
+// lets queued subscription updates and completion callbacks reach PAManager between samples
+void drain(int ms) {
+	QEventLoop loop;
+	QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+	loop.exec();
+}
+
+QJsonObject summarize(std::vector<double> samples) {
+	QJsonObject obj;
+	if (samples.empty())
+		return obj;
+
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for (double s : samples)
+		sum += s;
+	obj["p50"] = samples[samples.size() / 2];
+	obj["max"] = samples.back();
+	obj["mean"] = sum / samples.size();
+	return obj;
+}
+
+template <typename F>
+double timeUs(F&& f) {
+	QElapsedTimer t;
+	t.start();
+	f();
+	return t.nsecsElapsed() / 1000.0;
+}
+
+// time until the operation started by f has been acknowledged by the server
+template <typename F>
+double timeDoneUs(F&& f) {
+	QElapsedTimer t;
+	t.start();
+	QFuture<bool> done = f();
+	while (!done.isFinished())
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 5);
+	return t.nsecsElapsed() / 1000.0;
+}
+
+// PAManager connects in the background, wait until it has the sinks
+void waitReady(PAManager& pulse) {
+	while (!pulse.isReady())
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 5);
+}
+
+QJsonObject runOnce(int sinks, int repeat, const QString& binary) {
+	PrivateServer server(binary, sinks);
+	qputenv("PULSE_SERVER", ("unix:" + server.socketPath()).toUtf8());
+
+	QJsonObject result;
+	result["sinks"] = sinks;
+
+	std::vector<double> construct, ready;
+	for (int i = 0; i < std::max(1, repeat / 4); i++) {
+		std::unique_ptr<PAManager> pulse;
+		construct.push_back(
+				timeUs([&pulse] { pulse = std::make_unique<PAManager>("vrdio bench", false); }) / 1000.0);
+		ready.push_back(construct.back() + timeUs([&pulse] { waitReady(*pulse); }) / 1000.0);
+		drain(5);
+	}
+	result["construct_ms"] = summarize(construct);
+	result["ready_ms"] = summarize(ready);
+
+	// the user's saved sink, rules and mirror targets would queue their own work into the runs
+	PAManager pulse("vrdio bench", false);
+	waitReady(pulse);
+	drain(20);
+
+	std::vector<double> listRead, switchSink, switchSinkDone, volume, volumeDone, cardProfile;
+	for (int i = 0; i < repeat; i++) {
+		listRead.push_back(timeUs([&pulse] {
+			SinkModel* model = pulse.getSinks();
+			for (int row = 0; row < model->rowCount(); row++)
+				model->data(model->index(row), SinkModel::DescriptionRole);
+		}));
+
+		int target = (pulse.getDefaultSinkIndex() + 1) % std::max(1, sinks);
+		switchSink.push_back(timeUs([&pulse, target] { pulse.changeSink(target); }));
+		drain(5);
+		int next = (target + 1) % std::max(1, sinks);
+		switchSinkDone.push_back(timeDoneUs([&pulse, next] { return pulse.changeSink(next); }));
+		drain(5);
+
+		volume.push_back(timeUs([&pulse, i] { pulse.changeVol(i % 2 ? 40 : 60); }));
+		drain(5);
+		volumeDone.push_back(timeDoneUs([&pulse, i] { return pulse.changeVol(i % 2 ? 45 : 55); }));
+		drain(5);
+	}
+
+	// a slider drag: a change per step, without waiting for the server in between
+	std::vector<double> drag;
+	qint64 droppedBefore = pulse.getDroppedVolumeOps();
+	for (int i = 0; i < std::max(1, repeat / 4); i++) {
+		drag.push_back(timeUs([&pulse] {
+			QFuture<bool> last;
+			for (int v = 0; v <= 100; v++)
+				last = pulse.changeVol(v);
+			while (!last.isFinished())
+				QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 5);
+		}) / 1000.0);
+		drain(5);
+	}
+
+	// null sinks have no cards, so this only measures something against a real server
+	result["load_cards_ms"] = timeDoneUs([&pulse] { return pulse.loadCards(); }) / 1000.0;
+	for (int row = 0; row < pulse.getCards()->rowCount(); row++) {
+		Card* card = pulse.getCards()->get(row);
+		QStringList profiles;
+		for (const Profile& p : card->availableProfiles())
+			profiles << QString::fromStdString(p.description);
+		if (profiles.size() < 2)
+			continue;
+
+		for (int i = 0; i < repeat; i++) {
+			cardProfile.push_back(timeDoneUs([&pulse, card, &profiles, i] {
+				return pulse.changeCardProfile(card, profiles[i % 2]);
+			}) / 1000.0);
+			drain(20);
+		}
+		break;
+	}
+
+	result["sink_list_read_us"] = summarize(listRead);
+	result["change_sink_us"] = summarize(switchSink);
+	result["change_sink_done_us"] = summarize(switchSinkDone);
+	result["change_volume_us"] = summarize(volume);
+	result["change_volume_done_us"] = summarize(volumeDone);
+	result["volume_drag_ms"] = summarize(drag);
+	result["volume_drag_dropped"] = pulse.getDroppedVolumeOps() - droppedBefore;
+	result["change_card_profile_ms"] =
+			cardProfile.empty() ? QJsonValue() : QJsonValue(summarize(cardProfile));
+	return result;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+	QCoreApplication a(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Benchmark of PAManager against a private PulseAudio server");
+	parser.addHelpOption();
+	parser.addOption({"sinks", "Comma separated sink counts to test.", "list",
+			"1,5,10,25,50,100,250,500"});
+	parser.addOption({"repeat", "Samples per operation.", "count", "40"});
+	parser.addOption({"server-binary", "PulseAudio compatible server to start.", "path",
+			"pulseaudio"});
+	parser.process(a);
+
+	const int repeat = std::max(1, parser.value("repeat").toInt());
+	for (const QString& n : parser.value("sinks").split(',', Qt::SkipEmptyParts)) {
+		try {
+			QJsonObject result = runOnce(n.toInt(), repeat, parser.value("server-binary"));
+			std::cout << QJsonDocument(result).toJson(QJsonDocument::Compact).constData()
+					  << std::endl;
+		} catch (const std::exception& e) {
+			std::cerr << "sinks=" << n.toStdString() << ": " << e.what() << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
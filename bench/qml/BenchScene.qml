@@ -0,0 +1,42 @@
+import QtQuick 6.0
+import QtQuick.Controls 6.0
+
+// stand-in for main.qml built from the same components, without needing a PulseAudio connection
+Page {
+    width: screenWidth
+    height: screenHeight
+    background: Rectangle{
+        anchors.fill: parent
+        gradient: Gradient{
+            GradientStop { position: 0.0; color: "#464A4B" }
+            GradientStop { position: 0.7; color: "#292C32" }
+        }
+    }
+
+    HeaderText{
+        id: sinkText
+        text: "Default Output"
+        y: 100
+        anchors.horizontalCenter: parent.horizontalCenter
+    }
+
+    VRComboBox{
+        id: sinkDropdown
+        anchors.top: sinkText.bottom
+        anchors.topMargin: 20
+        anchors.horizontalCenter: sinkText.horizontalCenter
+        width: 1300
+        model: ["Built-in Audio Analog Stereo", "HDMI / DisplayPort", "Valve Index Headset"]
+    }
+
+    // render_bench.cpp drags across this, keep the two in sync
+    VolumeSlider {
+        id: slider
+        x: 400
+        y: 500
+        width: 1300
+        from: 0
+        to: 100
+        value: 50
+    }
+}
@@ -0,0 +1,235 @@
+#include "mockvr.h"
+#include "vrmanager.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQuickRenderControl>
+#include <QtQuick>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <vector>
+// render_bench.cpp: drives VRManager's render loop against mockvr with scripted input, and
+// reports what each tick costs. runs on any Vulkan driver, including lavapipe
+
+using namespace vr;
+
+/* allocation counting: malloc is replaced for the whole process, so operator new and Qt's
+   containers, which allocate with malloc directly, are both counted. aligned allocations
+   (posix_memalign, aligned_alloc) are left to glibc and not counted */
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+}
+
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+void __libc_free(void* p);
+
+void* malloc(std::size_t size) noexcept {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+void* calloc(std::size_t count, std::size_t size) noexcept {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(count, size);
+}
+void* realloc(void* p, std::size_t size) noexcept {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+void free(void* p) noexcept { __libc_free(p); }
+}
+
+namespace {
+// overlay size and slider geometry from BenchScene.qml, in layout units. SteamVR mouse
+// coordinates are these times --scale
+constexpr float overlayHeight = 1200;
+constexpr float sliderLeft = 450;
+constexpr float sliderRight = 1650;
+constexpr float sliderY = overlayHeight - 550;
+
+// one cycle: drag the slider across for the first half, then leave the overlay mostly alone
+constexpr int cycleLength = 240;
+
+void scriptTick(int tick, int movesPerTick, float scale) {
+	const auto overlay = mockvr::dashboardHandle;
+	const int t = tick % cycleLength;
+	const int dragLength = cycleLength / 2;
+
+	if (t < dragLength) {
+		float x = (sliderLeft + (sliderRight - sliderLeft) * t / dragLength) * scale;
+		float y = sliderY * scale;
+		if (t == 0)
+			mockvr::pushMouse(overlay, VREvent_MouseButtonDown, x, y);
+		for (int i = 0; i < movesPerTick; i++)
+			mockvr::pushMouse(overlay, VREvent_MouseMove, x + i, y);
+		if (t == dragLength - 1)
+			mockvr::pushMouse(overlay, VREvent_MouseButtonUp, x, y);
+	} else if (t % 30 == 0) {
+		mockvr::pushScroll(overlay, 1.0f);
+	}
+}
+
+qint64 threadCpuNs() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+QJsonObject summarize(std::vector<double> samples) {
+	QJsonObject obj;
+	obj["count"] = qint64(samples.size());
+	if (samples.empty())
+		return obj;
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&samples](double p) {
+		return samples[std::min(samples.size() - 1, size_t(p * samples.size()))];
+	};
+	double sum = 0;
+	for (double s : samples)
+		sum += s;
+
+	obj["p50"] = percentile(0.50);
+	obj["p99"] = percentile(0.99);
+	obj["max"] = samples.back();
+	obj["mean"] = sum / samples.size();
+	return obj;
+}
+
+void printRow(const char* name, const QJsonObject& obj) {
+	if (obj["count"].toInt() == 0) {
+		std::printf("%-26s %10s\n", name, "-");
+		return;
+	}
+	std::printf("%-26s %10.1f %10.1f %10.1f %10.1f\n", name, obj["p50"].toDouble(),
+			obj["p99"].toDouble(), obj["mean"].toDouble(), obj["max"].toDouble());
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+	QQuickWindow::setGraphicsApi(QSGRendererInterface::Vulkan);
+	QGuiApplication a(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Headless benchmark of the vrdio render loop");
+	parser.addHelpOption();
+	parser.addOption({"ticks", "Number of ticks to run.", "count", "2400"});
+	parser.addOption({"moves", "Mouse moves injected per tick while dragging.", "count", "4"});
+	parser.addOption({"always-render", "Render every tick, even if nothing changed."});
+	parser.addOption({"scale", "Overlay scale, see vrdio --overlay-scale.", "scale", "1.0"});
+	parser.addOption({"json", "Print the results as JSON."});
+	parser.process(a);
+
+	const int ticks = std::max(1, parser.value("ticks").toInt());
+	const int moves = std::max(0, parser.value("moves").toInt());
+	const float scale = std::clamp(parser.value("scale").toFloat(), float(VRManager::minScale),
+			float(VRManager::maxScale));
+
+	QQuickRenderControl renderCtrl;
+	QQuickView w(QUrl(), &renderCtrl);
+	VRManager ctrl(&w, &renderCtrl);
+	ctrl.setDamageTracking(!parser.isSet("always-render"));
+	VRManager::OverlaySize size;
+	size.scale = scale;
+	ctrl.setOverlaySize(size);
+
+	w.setSource(QUrl("qrc:///BenchScene.qml"));
+	if (!renderCtrl.initialize()) {
+		std::cerr << "Failed to initialize QQuickRenderControl!" << std::endl;
+		return 1;
+	}
+	ctrl.buildOverlay();
+
+	// ticks are driven from here, keep VRManager's own timer out of the way
+	VRManager::FrameIntervals never;
+	never.hidden = never.idle = never.active = never.activeTimeout = 3600 * 1000;
+	ctrl.setFrameIntervals(never);
+
+	// warm up: the first frame creates pipelines and glyph caches
+	ctrl.checkRender();
+	QCoreApplication::processEvents();
+	mockvr::resetCounters();
+	const VRManager::FrameStats before = ctrl.frameStats();
+
+	std::vector<double> tickWall, tickCpu, tickAllocs, frameLatency, frameSubmit;
+	tickWall.reserve(ticks);
+	tickCpu.reserve(ticks);
+	tickAllocs.reserve(ticks);
+	frameLatency.reserve(ticks);
+	frameSubmit.reserve(ticks);
+
+	for (int tick = 0; tick < ticks; tick++) {
+		scriptTick(tick, moves, scale);
+
+		const quint64 rendered = ctrl.frameStats().rendered;
+		const uint64_t allocs = allocations.load(std::memory_order_relaxed);
+		const qint64 cpu = threadCpuNs();
+		QElapsedTimer wall;
+		wall.start();
+
+		ctrl.checkRender();
+
+		const double wallUs = wall.nsecsElapsed() / 1000.0;
+		tickWall.push_back(wallUs);
+		tickCpu.push_back((threadCpuNs() - cpu) / 1000.0);
+		tickAllocs.push_back(allocations.load(std::memory_order_relaxed) - allocs);
+
+		// input is injected right before the tick, so for ticks that produced a frame the tick
+		// time is the latency from input to SetOverlayTexture
+		if (ctrl.frameStats().rendered != rendered) {
+			frameLatency.push_back(wallUs);
+			frameSubmit.push_back(ctrl.frameStats().submitNs / 1000.0);
+		}
+
+		// deliver whatever Qt queued up, outside of the measurement
+		QCoreApplication::processEvents();
+	}
+
+	const mockvr::Counters counters = mockvr::counters();
+	QJsonObject results;
+	results["ticks"] = ticks;
+	results["scale"] = scale;
+	results["rendered"] = qint64(ctrl.frameStats().rendered - before.rendered);
+	results["skipped"] = qint64(ctrl.frameStats().skipped - before.skipped);
+	results["texture_submits"] = qint64(counters.textureSubmits);
+	results["overlay_events"] = qint64(counters.overlayEventsPolled);
+	const VRManager::FrameStats& after = ctrl.frameStats();
+	results["input_events"] = qint64(after.inputEvents - before.inputEvents);
+	results["input_dispatched"] = qint64(after.inputDispatched - before.inputDispatched);
+	results["tick_wall_us"] = summarize(tickWall);
+	results["tick_cpu_us"] = summarize(tickCpu);
+	results["frame_latency_us"] = summarize(frameLatency);
+	results["gpu_submit_us"] = summarize(frameSubmit);
+	results["allocs_per_tick"] = summarize(tickAllocs);
+
+	if (parser.isSet("json")) {
+		std::cout << QJsonDocument(results).toJson(QJsonDocument::Compact).constData()
+				  << std::endl;
+		return 0;
+	}
+
+	std::printf("%d ticks: %lld rendered, %lld skipped, %lld texture submits\n", ticks,
+			results["rendered"].toVariant().toLongLong(),
+			results["skipped"].toVariant().toLongLong(),
+			results["texture_submits"].toVariant().toLongLong());
+	std::printf("%lld input events, %lld dispatched to QML\n\n",
+			results["input_events"].toVariant().toLongLong(),
+			results["input_dispatched"].toVariant().toLongLong());
+	std::printf("%-26s %10s %10s %10s %10s\n", "", "p50", "p99", "mean", "max");
+	printRow("tick wall time (us)", results["tick_wall_us"].toObject());
+	printRow("tick cpu time (us)", results["tick_cpu_us"].toObject());
+	printRow("frame latency (us)", results["frame_latency_us"].toObject());
+	printRow("gpu submit (us)", results["gpu_submit_us"].toObject());
+	printRow("allocations per tick", results["allocs_per_tick"].toObject());
+	return 0;
+}
@@ -0,0 +1,443 @@
+#include "audiomirror.h"
+#include "strs.h"
+#include "trace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+namespace {
+// how far the resampler may speed up or slow down playback to follow clock drift. real clocks
+// drift apart by a few hundred ppm, this leaves room to recover from a burst too
+constexpr double maxCorrection = 0.005;
+// how strongly the fill level error steers the ratio, and how much of that each callback applies
+constexpr double correctionGain = 0.005;
+constexpr double smoothing = 0.05;
+} // namespace
+
+AudioMirror::AudioMirror(QObject* parent)
+	: QObject(parent), enabled(false), latency(20), captureLoop(nullptr), captureContext(nullptr),
+	  captureStream(nullptr), playbackLoop(nullptr), playbackContext(nullptr), underruns(0),
+	  overruns(0), driftPpm(0) {
+	statsTimer.setInterval(1000);
+	connect(&statsTimer, SIGNAL(timeout()), this, SLOT(pollStats()));
+}
+
+AudioMirror::~AudioMirror() {
+	stop();
+	closeContexts();
+}
+
+void AudioMirror::setSource(const std::string& monitor, const std::string& sink) {
+	if (monitor == sourceName && sink == sourceSink)
+		return;
+
+	sourceName = monitor;
+	sourceSink = sink;
+	restart();
+}
+
+bool AudioMirror::isEnabled() const { return enabled; }
+
+int AudioMirror::getLatency() const { return latency; }
+
+QStringList AudioMirror::getTargets() const { return targetNames; }
+
+qint64 AudioMirror::getUnderruns() const { return underruns; }
+
+qint64 AudioMirror::getOverruns() const { return overruns; }
+
+int AudioMirror::getDriftPpm() const { return driftPpm; }
+
+void AudioMirror::setEnabled(bool e) {
+	if (e == enabled)
+		return;
+
+	enabled = e;
+	restart();
+	saveConfig();
+	emit enabledChanged();
+}
+
+void AudioMirror::setLatency(int ms) {
+	ms = std::clamp(ms, minLatency, maxLatency);
+	if (ms == latency)
+		return;
+
+	latency = ms;
+	restart();
+	saveConfig();
+	emit latencyChanged();
+}
+
+void AudioMirror::setTarget(const QString& sinkName, bool mirrored) {
+	if (targetNames.contains(sinkName) == mirrored)
+		return;
+
+	if (mirrored)
+		targetNames << sinkName;
+	else
+		targetNames.removeAll(sinkName);
+	restart();
+	saveConfig();
+	emit targetsChanged();
+}
+
+bool AudioMirror::saveConfig() {
+	QDir config_dir(strings::config_dir_loc);
+	if (!config_dir.exists()) {
+		if (!config_dir.mkpath(strings::config_dir_loc)) {
+			std::cerr << "Could not create config directory!" << std::endl;
+			return false;
+		}
+	}
+	QFile config(strings::mirrorconfig_loc);
+	if (!config.open(QFile::WriteOnly)) {
+		std::cerr << "Could not open mirrorconfig.txt for writing!" << std::endl;
+		return false;
+	}
+	QTextStream out(&config);
+	out << "Enabled: " << (enabled ? 1 : 0) << '\n';
+	out << "Latency: " << latency << '\n';
+	for (const QString& target : targetNames)
+		out << "Target: " << target << '\n';
+
+	return true;
+}
+
+void AudioMirror::loadConfig() {
+	QFile config(strings::mirrorconfig_loc);
+	if (!config.open(QFile::ReadOnly))
+		return;
+
+	QTextStream in(&config);
+	QStringList loadedTargets;
+	bool loadedEnabled = false;
+	int loadedLatency = latency;
+	while (!in.atEnd()) {
+		QString line = in.readLine();
+		if (line.startsWith("Enabled: "))
+			loadedEnabled = line.mid(9).toInt() != 0;
+		else if (line.startsWith("Latency: "))
+			loadedLatency = std::clamp(line.mid(9).toInt(), minLatency, maxLatency);
+		else if (line.startsWith("Target: "))
+			loadedTargets << line.mid(8);
+	}
+
+	enabled = loadedEnabled;
+	latency = loadedLatency;
+	targetNames = loadedTargets;
+	restart();
+	emit enabledChanged();
+	emit latencyChanged();
+	emit targetsChanged();
+}
+
+void AudioMirror::pollStats() {
+	quint64 u = 0, o = 0;
+	int drift = 0;
+	for (const auto& t : targets) {
+		u += t->underruns;
+		o += t->overruns;
+		int d = t->driftPpm;
+		if (std::abs(d) > std::abs(drift))
+			drift = d;
+	}
+
+	if (u == underruns && o == overruns && drift == driftPpm)
+		return;
+
+	underruns = u;
+	overruns = o;
+	driftPpm = drift;
+	emit statsChanged();
+}
+
+/* engine */
+
+void AudioMirror::restart() {
+	stop();
+	start();
+}
+
+void AudioMirror::start() {
+	if (!enabled || sourceName.empty() || !targets.empty())
+		return;
+
+	// mirroring the default sink onto itself would just double it
+	std::vector<std::string> sinks;
+	for (const QString& name : targetNames) {
+		if (name.toStdString() != sourceSink)
+			sinks.push_back(name.toStdString());
+	}
+	if (sinks.empty())
+		return;
+
+	// nothing here waits for the server, contextChanged() calls this again once it's connected
+	if (!captureLoop) {
+		connectContexts();
+		return;
+	}
+	if (!contextsReady())
+		return;
+
+	// half of the latency is buffered in the ring, the rest in the server
+	size_t fillTarget = static_cast<size_t>(rate) * latency / 2000;
+	for (const auto& sink : sinks) {
+		auto t = std::make_unique<Target>();
+		t->sink = sink;
+		t->fillTarget = std::max<size_t>(fillTarget, 1);
+		targets.push_back(std::move(t));
+	}
+
+	pa_threaded_mainloop_lock(playbackLoop);
+	for (auto& t : targets)
+		startTarget(*t);
+	pa_threaded_mainloop_unlock(playbackLoop);
+
+	// capture goes last, so every ring has its reader before audio arrives
+	pa_sample_spec ss{PA_SAMPLE_FLOAT32NE, rate, channels};
+	pa_buffer_attr attr;
+	attr.maxlength = static_cast<uint32_t>(-1);
+	attr.fragsize = pa_usec_to_bytes(latency * 1000 / 4, &ss);
+
+	pa_threaded_mainloop_lock(captureLoop);
+	captureStream = pa_stream_new(captureContext, "Mirror capture", &ss, nullptr);
+	if (captureStream) {
+		pa_stream_set_read_callback(captureStream, &AudioMirror::readCallback, this);
+		auto flags = static_cast<pa_stream_flags_t>(PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE);
+		if (pa_stream_connect_record(captureStream, sourceName.c_str(), &attr, flags) < 0) {
+			std::cerr << "Could not record from " << sourceName << ": "
+					  << pa_strerror(pa_context_errno(captureContext)) << std::endl;
+			pa_stream_unref(captureStream);
+			captureStream = nullptr;
+		}
+	}
+	pa_threaded_mainloop_unlock(captureLoop);
+
+	statsTimer.start();
+}
+
+// playbackLoop has to be locked
+void AudioMirror::startTarget(Target& t) {
+	pa_sample_spec ss{PA_SAMPLE_FLOAT32NE, rate, channels};
+
+	// mark the stream, so PAManager can leave it out of the application list
+	pa_proplist* props = pa_proplist_new();
+	pa_proplist_sets(props, strings::mirror_prop, "1");
+	t.stream = pa_stream_new_with_proplist(playbackContext, "Mirror", &ss, nullptr, props);
+	pa_proplist_free(props);
+	if (!t.stream)
+		return;
+
+	pa_buffer_attr attr;
+	attr.maxlength = static_cast<uint32_t>(-1);
+	attr.tlength = pa_usec_to_bytes(latency * 1000 / 2, &ss);
+	attr.prebuf = static_cast<uint32_t>(-1);
+	attr.minreq = static_cast<uint32_t>(-1);
+	attr.fragsize = static_cast<uint32_t>(-1);
+
+	pa_stream_set_write_callback(t.stream, &AudioMirror::writeCallback, &t);
+	auto flags = static_cast<pa_stream_flags_t>(PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE);
+	if (pa_stream_connect_playback(t.stream, t.sink.c_str(), &attr, flags, nullptr, nullptr) < 0) {
+		std::cerr << "Could not mirror to " << t.sink << ": "
+				  << pa_strerror(pa_context_errno(playbackContext)) << std::endl;
+		pa_stream_unref(t.stream);
+		t.stream = nullptr;
+	}
+}
+
+void AudioMirror::stop() {
+	statsTimer.stop();
+
+	// producer first, so nothing writes to the rings while the targets go away
+	if (captureLoop) {
+		pa_threaded_mainloop_lock(captureLoop);
+		if (captureStream) {
+			pa_stream_set_read_callback(captureStream, nullptr, nullptr);
+			pa_stream_disconnect(captureStream);
+			pa_stream_unref(captureStream);
+			captureStream = nullptr;
+		}
+		pa_threaded_mainloop_unlock(captureLoop);
+	}
+
+	if (playbackLoop) {
+		pa_threaded_mainloop_lock(playbackLoop);
+		for (auto& t : targets) {
+			if (!t->stream)
+				continue;
+			pa_stream_set_write_callback(t->stream, nullptr, nullptr);
+			pa_stream_disconnect(t->stream);
+			pa_stream_unref(t->stream);
+			t->stream = nullptr;
+		}
+		pa_threaded_mainloop_unlock(playbackLoop);
+	}
+
+	targets.clear();
+}
+
+void AudioMirror::connectContexts() {
+	captureLoop = pa_threaded_mainloop_new();
+	pa_threaded_mainloop_set_name(captureLoop, "vrdio-capture");
+	captureContext = connectContext(captureLoop, "VR Audio Control mirror capture");
+	playbackLoop = pa_threaded_mainloop_new();
+	pa_threaded_mainloop_set_name(playbackLoop, "vrdio-playback");
+	playbackContext = connectContext(playbackLoop, "VR Audio Control mirror");
+	if (!captureContext || !playbackContext) {
+		std::cerr << "Could not connect to the server for mirroring!" << std::endl;
+		closeContexts();
+	}
+}
+
+void AudioMirror::closeContexts() {
+	for (auto [loop, context] : {std::pair{&captureLoop, &captureContext},
+				 std::pair{&playbackLoop, &playbackContext}}) {
+		if (!*loop)
+			continue;
+		pa_threaded_mainloop_lock(*loop);
+		if (*context) {
+			pa_context_set_state_callback(*context, nullptr, nullptr);
+			pa_context_disconnect(*context);
+		}
+		pa_threaded_mainloop_unlock(*loop);
+		pa_threaded_mainloop_stop(*loop);
+		if (*context)
+			pa_context_unref(*context);
+		pa_threaded_mainloop_free(*loop);
+		*context = nullptr;
+		*loop = nullptr;
+	}
+}
+
+bool AudioMirror::contextsReady() const {
+	bool ready = true;
+	for (auto [loop, context] :
+			{std::pair{captureLoop, captureContext}, std::pair{playbackLoop, playbackContext}}) {
+		pa_threaded_mainloop_lock(loop);
+		ready = ready && pa_context_get_state(context) == PA_CONTEXT_READY;
+		pa_threaded_mainloop_unlock(loop);
+	}
+	return ready;
+}
+
+void AudioMirror::contextChanged() {
+	if (!captureLoop)
+		return;
+
+	bool failed = false;
+	for (auto [loop, context] :
+			{std::pair{captureLoop, captureContext}, std::pair{playbackLoop, playbackContext}}) {
+		pa_threaded_mainloop_lock(loop);
+		failed = failed || !PA_CONTEXT_IS_GOOD(pa_context_get_state(context));
+		pa_threaded_mainloop_unlock(loop);
+	}
+	// connected again the next time mirroring restarts
+	if (failed) {
+		std::cerr << "Lost the connection for mirroring!" << std::endl;
+		stop();
+		closeContexts();
+		return;
+	}
+	start();
+}
+
+void AudioMirror::contextStateCallback(pa_context* c, void* userdata) {
+	auto self = static_cast<AudioMirror*>(userdata);
+	pa_context_state_t state = pa_context_get_state(c);
+	if (state == PA_CONTEXT_READY || !PA_CONTEXT_IS_GOOD(state))
+		QMetaObject::invokeMethod(self, [self] { self->contextChanged(); }, Qt::QueuedConnection);
+}
+
+pa_context* AudioMirror::connectContext(pa_threaded_mainloop* ml, const char* name) {
+	pa_context* c = pa_context_new(pa_threaded_mainloop_get_api(ml), name);
+	pa_context_set_state_callback(c, &AudioMirror::contextStateCallback, this);
+	if (pa_context_connect(c, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
+		pa_context_unref(c);
+		return nullptr;
+	}
+	pa_threaded_mainloop_start(ml);
+	return c;
+}
+
+void AudioMirror::readCallback(pa_stream* s, size_t, void* userdata) {
+	Trace::Span span("AudioMirror::readCallback");
+	auto self = static_cast<AudioMirror*>(userdata);
+
+	while (pa_stream_readable_size(s) > 0) {
+		const void* data;
+		size_t nbytes;
+		if (pa_stream_peek(s, &data, &nbytes) < 0 || nbytes == 0)
+			return;
+
+		// data is null if there's a hole in the stream
+		if (data) {
+			auto samples = static_cast<const float*>(data);
+			size_t count = nbytes / sizeof(float);
+			count -= count % channels;
+			// the target list only changes while capture is stopped
+			for (auto& t : self->targets) {
+				if (t->ring.write(samples, count) < count)
+					t->overruns++;
+			}
+		}
+		pa_stream_drop(s);
+	}
+}
+
+void AudioMirror::writeCallback(pa_stream* s, size_t nbytes, void* userdata) {
+	Trace::Span span("AudioMirror::writeCallback");
+	auto t = static_cast<Target*>(userdata);
+
+	void* data = nullptr;
+	size_t bytes = nbytes;
+	if (pa_stream_begin_write(s, &data, &bytes) < 0 || !data)
+		return;
+
+	size_t frames = bytes / (sizeof(float) * channels);
+	t->render(static_cast<float*>(data), frames);
+	pa_stream_write(s, data, frames * sizeof(float) * channels, nullptr, 0, PA_SEEK_RELATIVE);
+}
+
+void AudioMirror::Target::render(float* out, size_t frames) {
+	size_t fill = ring.size() / channels;
+	if (!primed) {
+		// build up the latency target first, otherwise we'd run dry again right away
+		if (fill < fillTarget) {
+			std::fill(out, out + frames * channels, 0.f);
+			return;
+		}
+		primed = true;
+	}
+
+	// the source and target clocks drift apart, which shows up as the ring slowly filling up or
+	// draining. play slightly faster or slower to keep it around fillTarget
+	double error = (static_cast<double>(fill) - fillTarget) / fillTarget;
+	double wanted = 1.0 + std::clamp(error * correctionGain, -maxCorrection, maxCorrection);
+	ratio += (wanted - ratio) * smoothing;
+	driftPpm = std::lround((ratio - 1.0) * 1e6);
+
+	for (size_t f = 0; f < frames; f++) {
+		// linear interpolation between the input frames around the read position
+		while (phase >= 1.0) {
+			std::copy(next, next + channels, prev);
+			if (ring.read(next, channels) < channels) {
+				// ran dry, pad with silence until the ring is back at fillTarget
+				underruns++;
+				primed = false;
+				std::fill(out + f * channels, out + frames * channels, 0.f);
+				return;
+			}
+			phase -= 1.0;
+		}
+
+		for (int c = 0; c < channels; c++)
+			out[f * channels + c] = prev[c] + (next[c] - prev[c]) * phase;
+		phase += ratio;
+	}
+}
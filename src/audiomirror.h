@@ -0,0 +1,126 @@
+#ifndef AUDIOMIRROR_H
+#define AUDIOMIRROR_H
+
+#include "spscring.h"
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <pulse/pulseaudio.h>
+#include <string>
+#include <vector>
+// audiomirror.h: plays whatever the default sink plays on other sinks as well
+
+class AudioMirror : public QObject {
+	Q_OBJECT
+	Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+	Q_PROPERTY(int latency READ getLatency WRITE setLatency NOTIFY latencyChanged)
+	Q_PROPERTY(QStringList targets READ getTargets NOTIFY targetsChanged)
+	Q_PROPERTY(qint64 underruns READ getUnderruns NOTIFY statsChanged)
+	Q_PROPERTY(qint64 overruns READ getOverruns NOTIFY statsChanged)
+	Q_PROPERTY(int driftPpm READ getDriftPpm NOTIFY statsChanged)
+  public:
+	static constexpr int minLatency = 5;   // ms
+	static constexpr int maxLatency = 200; // ms
+
+	explicit AudioMirror(QObject* parent = nullptr);
+	~AudioMirror();
+
+	// monitor source of the default sink, and the sink's own name so it's never a target
+	void setSource(const std::string& monitor, const std::string& sink);
+
+	bool isEnabled() const;
+	int getLatency() const;
+	QStringList getTargets() const;
+	qint64 getUnderruns() const;
+	qint64 getOverruns() const;
+	int getDriftPpm() const;
+
+  public slots:
+	void setEnabled(bool enabled);
+	// latency target in ms, from the default sink's monitor to the target sinks
+	void setLatency(int ms);
+	void setTarget(const QString& sinkName, bool mirrored);
+
+	// mirror settings live next to audioconfig.txt
+	bool saveConfig();
+	void loadConfig();
+
+  signals:
+	void enabledChanged();
+	void latencyChanged();
+	void targetsChanged();
+	void statsChanged();
+
+  private slots:
+	void pollStats();
+
+  private:
+	static constexpr int channels = 2;
+	static constexpr uint32_t rate = 48000;
+	// ~340 ms of stereo audio, well over maxLatency
+	static constexpr size_t ringSize = 1 << 15;
+
+	// a sink being mirrored to. the ring is filled on the capture thread and emptied on the
+	// playback thread
+	struct Target {
+		std::string sink;
+		pa_stream* stream = nullptr;
+		SpscRing<float, ringSize> ring;
+		size_t fillTarget = 0; // frames the ring should hold
+
+		// playback thread only
+		bool primed = false; // holding back until the ring reached fillTarget
+		double ratio = 1.0;  // input frames consumed per output frame
+		double phase = 1.0;  // position between prev and next
+		float prev[channels] = {};
+		float next[channels] = {};
+
+		std::atomic<quint64> underruns{0};
+		std::atomic<quint64> overruns{0};
+		std::atomic<int> driftPpm{0};
+
+		void render(float* out, size_t frames);
+	};
+
+	bool enabled;
+	int latency;
+	QStringList targetNames;
+	std::string sourceName;
+	std::string sourceSink;
+
+	// capture and playback each get their own connection and thread, so a slow target never
+	// holds up recording. the connections are made the first time mirroring starts and kept
+	// across restarts, only the streams are recreated
+	pa_threaded_mainloop* captureLoop;
+	pa_context* captureContext;
+	pa_stream* captureStream;
+	pa_threaded_mainloop* playbackLoop;
+	pa_context* playbackContext;
+	std::vector<std::unique_ptr<Target>> targets;
+
+	QTimer statsTimer;
+	quint64 underruns, overruns;
+	int driftPpm;
+
+	void restart();
+	// starts the streams once both connections are ready, connecting first if needed
+	void start();
+	// stops the streams, the connections stay
+	void stop();
+	void startTarget(Target& t);
+	void connectContexts();
+	void closeContexts();
+	bool contextsReady() const;
+	// a connection became ready or failed
+	void contextChanged();
+
+	pa_context* connectContext(pa_threaded_mainloop* ml, const char* name);
+	static void contextStateCallback(pa_context* c, void* userdata);
+	static void readCallback(pa_stream* s, size_t nbytes, void* userdata);
+	static void writeCallback(pa_stream* s, size_t nbytes, void* userdata);
+};
+
+#endif // AUDIOMIRROR_H
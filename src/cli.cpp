@@ -0,0 +1,128 @@
+#include "cli.h"
+
+#include "pamanager.h"
+
+#include <QCoreApplication>
+#include <QFuture>
+#include <QJsonDocument>
+#include <QTimer>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+const char* const commands[] = {"set-sink", "volume", "apply-config", "list"};
+
+struct Step {
+	const char* name;
+	std::function<QFuture<bool>()> start;
+};
+
+// one after another, so e.g. a --set-sink isn't overtaken by the sink --apply-config switches
+// to once its profile is up. done gets whether all of them succeeded
+void runSteps(PAManager* pulse, const std::vector<Step>& steps, std::size_t i,
+		std::function<void(bool)> done) {
+	if (i == steps.size()) {
+		done(true);
+		return;
+	}
+	steps[i].start().then(pulse, [pulse, &steps, i, done](bool success) {
+		if (!success) {
+			std::cerr << "Could not " << steps[i].name << std::endl;
+			done(false);
+			return;
+		}
+		runSteps(pulse, steps, i + 1, done);
+	});
+}
+} // namespace
+
+bool Cli::requested(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+			continue;
+		arg += (arg[1] == '-') ? 2 : 1;
+		std::size_t length = std::strcspn(arg, "=");
+		for (const char* command : commands) {
+			if (std::strlen(command) == length && std::strncmp(arg, command, length) == 0)
+				return true;
+		}
+	}
+	return false;
+}
+
+void Cli::addOptions(QCommandLineParser& parser) {
+	parser.addOption({"set-sink", "Make the sink with this name the default output and exit.",
+			"name"});
+	parser.addOption({"volume", "Set the default output's volume and exit.", "percent"});
+	parser.addOption({"apply-config", "Apply the saved sink and card profile and exit."});
+	parser.addOption({"list", "Print the sinks and cards as JSON and exit."});
+}
+
+int Cli::run(const QCommandLineParser& parser) {
+	// checked up front, so a typo doesn't leave half of the commands applied
+	int volume = -1;
+	if (parser.isSet("volume")) {
+		bool ok = false;
+		volume = parser.value("volume").toInt(&ok);
+		if (!ok || volume < 0 || volume > 100) {
+			std::cerr << "--volume expects a percentage from 0 to 100" << std::endl;
+			return 1;
+		}
+	}
+
+	// pamanager logs to stdout, which is kept for the JSON
+	std::streambuf* stdoutBuf = std::cout.rdbuf(std::clog.rdbuf());
+	std::ostream out(stdoutBuf);
+
+	PAManager pulse("VR Audio Control", false);
+	std::vector<Step> steps;
+	if (parser.isSet("apply-config"))
+		steps.push_back({"apply the saved configuration", [&pulse] { return pulse.loadConfig(); }});
+	if (parser.isSet("set-sink")) {
+		std::string name = parser.value("set-sink").toStdString();
+		auto setSink = [&pulse, name] { return pulse.changeSink(pulse.getSinks()->rowOf(name)); };
+		steps.push_back({"set the default sink", setSink});
+	}
+	if (volume != -1)
+		steps.push_back({"set the volume", [&pulse, volume] { return pulse.changeVol(volume); }});
+	if (parser.isSet("list"))
+		steps.push_back({"list the cards", [&pulse] { return pulse.loadCards(); }});
+
+	// armed until done, which quits either way
+	QTimer deadline;
+	deadline.setSingleShot(true);
+	QObject::connect(&deadline, &QTimer::timeout, [] {
+		std::cerr << "The commands did not finish in time" << std::endl;
+		QCoreApplication::exit(1);
+	});
+
+	auto done = [&](bool success) {
+		deadline.stop();
+		if (success && parser.isSet("list"))
+			out << QJsonDocument(pulse.toJson()).toJson(QJsonDocument::Compact).toStdString()
+				<< std::endl;
+		QCoreApplication::exit(success ? 0 : 1);
+	};
+
+	// ready is never emitted if the server can't be reached
+	QTimer timeout;
+	timeout.setSingleShot(true);
+	QObject::connect(&timeout, &QTimer::timeout, [] {
+		std::cerr << "Could not connect to PulseAudio" << std::endl;
+		QCoreApplication::exit(1);
+	});
+	QObject::connect(&pulse, &PAManager::readyChanged, [&] {
+		timeout.stop();
+		runSteps(&pulse, steps, 0, done);
+	});
+	timeout.start(connectTimeoutMs);
+	deadline.start(deadlineMs);
+
+	int ret = QCoreApplication::exec();
+	std::cout.rdbuf(stdoutBuf);
+	return ret;
+}
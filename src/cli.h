@@ -0,0 +1,25 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <QCommandLineParser>
+// cli.h: one-shot commands for scripts, e.g. game launch wrappers. they only need pulseaudio,
+// so they run on a QCoreApplication without OpenVR, vulkan or QML and exit when done
+
+class Cli {
+  public:
+	// whether argv has any of the commands. checked before there is an application, since
+	// that decides which application it is
+	static bool requested(int argc, char* argv[]);
+	static void addOptions(QCommandLineParser& parser);
+	// connects, runs the commands in order and returns the exit code. --list prints JSON to
+	// stdout, everything else is logged to stderr
+	static int run(const QCommandLineParser& parser);
+
+	// how long to wait for the server before giving up
+	static constexpr int connectTimeoutMs = 5000;
+	// how long all of the commands may take together, so a launch wrapper never hangs on an
+	// operation the server doesn't finish
+	static constexpr int deadlineMs = 30000;
+};
+
+#endif // CLI_H
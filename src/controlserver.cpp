@@ -0,0 +1,236 @@
+#include "controlserver.h"
+
+#include "pamanager.h"
+#include "trace.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QPointer>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+namespace {
+QJsonObject failure(const QString& error) { return {{"ok", false}, {"error", error}}; }
+
+// answers to a batch, in the order of its commands
+struct Batch {
+	QJsonArray results;
+	int pending;
+};
+} // namespace
+
+ControlServer::ControlServer(PAManager* pulse, QObject* parent) : QObject(parent), pulse(pulse) {
+	connect(&server, SIGNAL(newConnection()), this, SLOT(acceptClients()));
+	connect(pulse, SIGNAL(newDefaultSink()), this, SLOT(sendDefaultSink()));
+	connect(pulse, SIGNAL(volumeChanged()), this, SLOT(sendVolume()));
+	connect(pulse, SIGNAL(muteChanged()), this, SLOT(sendMute()));
+	connect(pulse, SIGNAL(operationFinished(QString, bool)), this,
+			SLOT(sendOperation(QString, bool)));
+	connect(pulse->getSinks(), SIGNAL(countChanged()), this, SLOT(sendSinks()));
+	connect(pulse->getCards(), SIGNAL(countChanged()), this, SLOT(sendCards()));
+	connect(pulse->getCards(), SIGNAL(profilesChanged()), this, SLOT(sendCards()));
+}
+
+bool ControlServer::listen(const QString& path) {
+	QLocalSocket probe;
+	probe.connectToServer(path);
+	if (probe.waitForConnected(100)) {
+		std::cerr << "Another vrdio is listening on " << path.toStdString() << std::endl;
+		return false;
+	}
+	QLocalServer::removeServer(path);
+
+	server.setSocketOptions(QLocalServer::UserAccessOption);
+	if (!server.listen(path)) {
+		std::cerr << "Could not open control socket " << path.toStdString() << ": "
+				  << server.errorString().toStdString() << std::endl;
+		return false;
+	}
+
+	// the overlay only fetches the cards when it's first shown, clients may ask for them right
+	// away. after that the subscription keeps them current
+	pulse->loadCards().then(this, [this](bool) {
+		cardsLoaded = true;
+		for (const Reply& reply : waitingForCards)
+			reply(state());
+		waitingForCards.clear();
+	});
+	return true;
+}
+
+void ControlServer::acceptClients() {
+	while (QLocalSocket* client = server.nextPendingConnection()) {
+		connect(client, SIGNAL(readyRead()), this, SLOT(readClient()));
+		connect(client, SIGNAL(disconnected()), this, SLOT(dropClient()));
+	}
+}
+
+void ControlServer::dropClient() {
+	auto client = qobject_cast<QLocalSocket*>(sender());
+	subscribers.erase(
+			std::remove(subscribers.begin(), subscribers.end(), client), subscribers.end());
+	client->deleteLater();
+}
+
+// one JSON value per line. an object is a command, an array a batch of them that is sent
+// without waiting in between and answered in one line once all of them are done
+void ControlServer::readClient() {
+	Trace::Span span("ControlServer::readClient");
+	auto client = qobject_cast<QLocalSocket*>(sender());
+	QPointer<QLocalSocket> target(client);
+	while (client->canReadLine()) {
+		QByteArray line = client->readLine().trimmed();
+		if (line.isEmpty())
+			continue;
+
+		QJsonParseError error;
+		QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+		if (doc.isObject()) {
+			run(client, doc.object(), [target](QJsonObject result) {
+				if (target)
+					send(target, result);
+			});
+		} else if (doc.isArray()) {
+			QJsonArray commands = doc.array();
+			auto batch = std::make_shared<Batch>();
+			batch->pending = commands.size();
+			for (int i = 0; i < commands.size(); i++)
+				batch->results.append(QJsonValue());
+			if (commands.isEmpty())
+				send(client, batch->results);
+			for (int i = 0; i < commands.size(); i++) {
+				run(client, commands[i].toObject(), [target, batch, i](QJsonObject result) {
+					batch->results[i] = result;
+					if (--batch->pending == 0 && target)
+						send(target, batch->results);
+				});
+			}
+		} else {
+			send(client, failure("Invalid JSON: " + error.errorString()));
+		}
+	}
+
+	if (client->bytesAvailable() > maxLineBytes) {
+		std::cerr << "Control client sent an overlong line, disconnecting it" << std::endl;
+		client->disconnectFromServer();
+	}
+}
+
+void ControlServer::run(QLocalSocket* client, const QJsonObject& command, Reply reply) {
+	// requests can carry an id to match them with their answers
+	QJsonValue id = command["id"];
+	if (!id.isUndefined())
+		reply = [reply, id](QJsonObject result) {
+			result["id"] = id;
+			reply(result);
+		};
+
+	const QString cmd = command["cmd"].toString();
+	if (cmd == "state") {
+		if (cardsLoaded)
+			reply(state());
+		else
+			waitingForCards.push_back(reply);
+	} else if (cmd == "subscribe") {
+		if (std::find(subscribers.begin(), subscribers.end(), client) == subscribers.end())
+			subscribers.push_back(client);
+		reply({{"ok", true}});
+	} else if (cmd == "set-sink") {
+		int row = pulse->getSinks()->rowOf(command["sink"].toString().toStdString());
+		if (row == -1)
+			reply(failure("No such sink"));
+		else
+			replyWhenDone(pulse->changeSink(row), reply);
+	} else if (cmd == "volume") {
+		int percent = command["percent"].toInt(-1);
+		if (percent < 0 || percent > 100)
+			reply(failure("percent must be from 0 to 100"));
+		else
+			replyWhenDone(pulse->changeVol(percent), reply);
+	} else if (cmd == "mute") {
+		if (!command["muted"].isBool())
+			reply(failure("muted must be true or false"));
+		else
+			replyWhenDone(pulse->setMute(command["muted"].toBool()), reply);
+	} else if (cmd == "profile") {
+		Card* card = pulse->getCards()->find(command["card"].toString().toStdString());
+		if (!card) {
+			reply(failure("No such card"));
+			return;
+		}
+		const std::string name = command["profile"].toString().toStdString();
+		const std::vector<Profile>& profiles = card->availableProfiles();
+		if (std::none_of(profiles.begin(), profiles.end(),
+				[&name](const Profile& p) { return p.name == name; }))
+			reply(failure("The card has no such profile"));
+		else
+			replyWhenDone(pulse->changeCardProfileByName(card, name), reply);
+	} else if (cmd == "preset") {
+		const QString name = command["name"].toString();
+		if (!pulse->getPresets().contains(name))
+			reply(failure("No such preset"));
+		else
+			replyWhenDone(pulse->applyPreset(name), reply);
+	} else {
+		reply(failure("Unknown command " + cmd));
+	}
+}
+
+QJsonObject ControlServer::state() const {
+	QJsonObject state = pulse->toJson();
+	state["presets"] = QJsonArray::fromStringList(pulse->getPresets());
+	return {{"ok", true}, {"state", state}};
+}
+
+void ControlServer::replyWhenDone(QFuture<bool> future, Reply reply) {
+	future.then(this, [reply](bool success) {
+		reply(success ? QJsonObject{{"ok", true}} : failure("The change was not applied"));
+	});
+}
+
+void ControlServer::send(QLocalSocket* client, const QJsonValue& message) {
+	QJsonDocument doc = message.isArray() ? QJsonDocument(message.toArray())
+										  : QJsonDocument(message.toObject());
+	client->write(doc.toJson(QJsonDocument::Compact) + '\n');
+}
+
+void ControlServer::broadcast(const QJsonObject& event) {
+	for (QLocalSocket* client : subscribers)
+		send(client, event);
+}
+
+void ControlServer::sendDefaultSink() {
+	if (subscribers.empty())
+		return;
+	int row = pulse->getDefaultSinkIndex();
+	QString name;
+	if (row != -1)
+		name = QString::fromStdString(pulse->getSinks()->at(row).name);
+	broadcast({{"event", "default-sink"}, {"sink", name}});
+}
+
+void ControlServer::sendVolume() {
+	if (!subscribers.empty())
+		broadcast({{"event", "volume"}, {"percent", pulse->getVolPct()}});
+}
+
+void ControlServer::sendMute() {
+	if (!subscribers.empty())
+		broadcast({{"event", "mute"}, {"muted", pulse->isMuted()}});
+}
+
+void ControlServer::sendOperation(const QString& kind, bool success) {
+	if (!subscribers.empty())
+		broadcast({{"event", "operation"}, {"kind", kind}, {"ok", success}});
+}
+
+void ControlServer::sendSinks() {
+	if (!subscribers.empty())
+		broadcast({{"event", "sinks"}, {"sinks", pulse->toJson()["sinks"]}});
+}
+
+void ControlServer::sendCards() {
+	if (!subscribers.empty())
+		broadcast({{"event", "cards"}, {"cards", pulse->toJson()["cards"]}});
+}
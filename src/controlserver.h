@@ -0,0 +1,61 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QFuture>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+#include <functional>
+#include <vector>
+// controlserver.h: lets other programs (stream decks, launch scripts, OBS hooks) control the
+// running vrdio through a unix socket. commands drive the overlay's own PAManager, so queries
+// are answered from its lists and changes share its connection to the server
+
+class PAManager;
+
+class ControlServer : public QObject {
+	Q_OBJECT
+  public:
+	explicit ControlServer(PAManager* pulse, QObject* parent = nullptr);
+	// fails if another vrdio is listening there. a socket left behind by a crash is replaced
+	bool listen(const QString& path);
+
+	// a client sending more than this without a newline is disconnected
+	static constexpr qint64 maxLineBytes = 64 << 10;
+
+  private slots:
+	void acceptClients();
+	void readClient();
+	void dropClient();
+	// events for subscribed clients
+	void sendDefaultSink();
+	void sendVolume();
+	void sendMute();
+	void sendOperation(const QString& kind, bool success);
+	// the whole list, as in state
+	void sendSinks();
+	void sendCards();
+
+  private:
+	PAManager* pulse;
+	QLocalServer server;
+	std::vector<QLocalSocket*> subscribers;
+
+	using Reply = std::function<void(QJsonObject)>;
+	// state is answered once the cards are known
+	bool cardsLoaded = false;
+	std::vector<Reply> waitingForCards;
+
+	// reply is called once, right away for queries and once the server answered for changes
+	void run(QLocalSocket* client, const QJsonObject& command, Reply reply);
+	void replyWhenDone(QFuture<bool> future, Reply reply);
+	// the answer to state
+	QJsonObject state() const;
+	void broadcast(const QJsonObject& event);
+	static void send(QLocalSocket* client, const QJsonValue& message);
+};
+
+#endif // CONTROLSERVER_H
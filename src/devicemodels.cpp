@@ -0,0 +1,306 @@
+#include "devicemodels.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool Profile::operator==(const Profile& other) const {
+	return (name == other.name && description == other.description && active == other.active
+			&& sinks == other.sinks);
+}
+
+int volumePct(const pa_cvolume& volume) {
+	return std::ceil(static_cast<double>(pa_cvolume_max(&volume)) / PA_VOLUME_NORM * 100);
+}
+
+/* sinks */
+
+SinkModel::SinkModel(QObject* parent) : QAbstractListModel(parent) {}
+
+int SinkModel::rowCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return sinks.size();
+}
+
+QVariant SinkModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid() || index.row() >= sinks.size())
+		return {};
+
+	const SinkInfo& s = sinks[index.row()];
+	switch (role) {
+	case Qt::DisplayRole:
+	case DescriptionRole:
+		return QString::fromStdString(s.description);
+	case NameRole:
+		return QString::fromStdString(s.name);
+	case VolumeRole:
+		return volumePct(s.volume);
+	case MutedRole:
+		return s.mute;
+	default:
+		return {};
+	}
+}
+
+QHash<int, QByteArray> SinkModel::roleNames() const {
+	return {
+			{NameRole, "name"},
+			{DescriptionRole, "description"},
+			{VolumeRole, "volume"},
+			{MutedRole, "muted"},
+	};
+}
+
+const SinkInfo& SinkModel::at(int row) const { return sinks[row]; }
+
+int SinkModel::rowOf(uint32_t index) const {
+	for (int i = 0; i < sinks.size(); i++) {
+		if (sinks[i].index == index)
+			return i;
+	}
+	return -1;
+}
+
+int SinkModel::rowOf(const std::string& name) const {
+	for (int i = 0; i < sinks.size(); i++) {
+		if (sinks[i].name == name)
+			return i;
+	}
+	return -1;
+}
+
+void SinkModel::update(const SinkInfo& info) {
+	int row = rowOf(info.index);
+	if (row == -1) {
+		beginInsertRows(QModelIndex(), sinks.size(), sinks.size());
+		sinks.push_back(info);
+		endInsertRows();
+		emit countChanged();
+		return;
+	}
+
+	SinkInfo& s = sinks[row];
+	QList<int> roles;
+	if (s.name != info.name)
+		roles << NameRole;
+	if (s.description != info.description)
+		roles << DescriptionRole << Qt::DisplayRole;
+	if (!pa_cvolume_equal(&s.volume, &info.volume))
+		roles << VolumeRole;
+	if (s.mute != info.mute)
+		roles << MutedRole;
+	s = info;
+
+	if (!roles.isEmpty())
+		emit dataChanged(this->index(row), this->index(row), roles);
+}
+
+void SinkModel::remove(uint32_t index) {
+	int row = rowOf(index);
+	if (row == -1)
+		return;
+
+	beginRemoveRows(QModelIndex(), row, row);
+	sinks.erase(sinks.begin() + row);
+	endRemoveRows();
+	emit countChanged();
+}
+
+/* profiles */
+
+ProfileModel::ProfileModel(QObject* parent) : QAbstractListModel(parent) {}
+
+int ProfileModel::rowCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return profiles.size();
+}
+
+QVariant ProfileModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid() || index.row() >= profiles.size())
+		return {};
+
+	const Profile& p = profiles[index.row()];
+	switch (role) {
+	case Qt::DisplayRole:
+	case DescriptionRole:
+		return QString::fromStdString(p.description);
+	case NameRole:
+		return QString::fromStdString(p.name);
+	case ActiveRole:
+		return p.active;
+	default:
+		return {};
+	}
+}
+
+QHash<int, QByteArray> ProfileModel::roleNames() const {
+	return {
+			{NameRole, "name"},
+			{DescriptionRole, "description"},
+			{ActiveRole, "active"},
+	};
+}
+
+const std::vector<Profile>& ProfileModel::list() const { return profiles; }
+
+void ProfileModel::update(const std::vector<Profile>& newProfiles) {
+	int oldCount = profiles.size();
+
+	// drop profiles that went away
+	for (int i = profiles.size() - 1; i >= 0; i--) {
+		bool gone = std::none_of(newProfiles.begin(), newProfiles.end(),
+				[this, i](const Profile& p) { return p.name == profiles[i].name; });
+		if (gone) {
+			beginRemoveRows(QModelIndex(), i, i);
+			profiles.erase(profiles.begin() + i);
+			endRemoveRows();
+		}
+	}
+
+	// pulseaudio keeps profiles in the same order, so what's left lines up with newProfiles
+	// apart from the gaps new profiles go into
+	for (int i = 0; i < newProfiles.size(); i++) {
+		if (i < profiles.size() && profiles[i].name == newProfiles[i].name) {
+			if (!(profiles[i] == newProfiles[i])) {
+				profiles[i] = newProfiles[i];
+				emit dataChanged(index(i), index(i));
+			}
+			continue;
+		}
+		beginInsertRows(QModelIndex(), i, i);
+		profiles.insert(profiles.begin() + i, newProfiles[i]);
+		endInsertRows();
+	}
+
+	// only left over if the order did change
+	if (profiles.size() > newProfiles.size()) {
+		beginRemoveRows(QModelIndex(), newProfiles.size(), profiles.size() - 1);
+		profiles.resize(newProfiles.size());
+		endRemoveRows();
+	}
+
+	if (profiles.size() != oldCount)
+		emit countChanged();
+}
+
+/* cards */
+
+Card::Card(QObject* parent)
+	: QObject(parent), index(PA_INVALID_INDEX), activeProfileIndex(0), profiles(this) {}
+
+ProfileModel* Card::getProfiles() { return &profiles; }
+
+const std::vector<Profile>& Card::availableProfiles() const { return profiles.list(); }
+
+Profile Card::getActiveProfile() const { return profiles.list()[activeProfileIndex]; }
+
+void Card::update(const CardInfo& info) {
+	name = info.name;
+	index = info.index;
+	alsaCard = info.alsaCard;
+
+	if (description != info.description) {
+		description = info.description;
+		emit descriptionChanged();
+	}
+
+	profiles.update(info.profiles);
+
+	if (activeProfileIndex != info.activeProfileIndex) {
+		activeProfileIndex = info.activeProfileIndex;
+		emit activeProfileChanged();
+	}
+}
+
+CardModel::CardModel(QObject* parent) : QAbstractListModel(parent) {}
+
+int CardModel::rowCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return cards.size();
+}
+
+QVariant CardModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid() || index.row() >= cards.size())
+		return {};
+
+	Card* c = cards[index.row()].get();
+	switch (role) {
+	case Qt::DisplayRole:
+	case DescriptionRole:
+		return c->description;
+	case CardRole:
+		return QVariant::fromValue(c);
+	default:
+		return {};
+	}
+}
+
+QHash<int, QByteArray> CardModel::roleNames() const {
+	return {
+			{DescriptionRole, "description"},
+			{CardRole, "card"},
+	};
+}
+
+Card* CardModel::get(int row) const {
+	if (row < 0 || row >= cards.size())
+		return nullptr;
+	return cards[row].get();
+}
+
+Card* CardModel::find(uint32_t index) const {
+	for (const auto& card : cards) {
+		if (card->index == index)
+			return card.get();
+	}
+	return nullptr;
+}
+
+Card* CardModel::find(const std::string& name) const {
+	for (const auto& card : cards) {
+		if (card->name == name)
+			return card.get();
+	}
+	return nullptr;
+}
+
+void CardModel::update(const CardInfo& info) {
+	for (int i = 0; i < cards.size(); i++) {
+		if (cards[i]->index == info.index) {
+			bool renamed = cards[i]->description != info.description;
+			bool switched = cards[i]->availableProfiles() != info.profiles ||
+					cards[i]->activeProfileIndex != info.activeProfileIndex;
+			cards[i]->update(info);
+			if (renamed)
+				emit dataChanged(index(i), index(i), {DescriptionRole, Qt::DisplayRole});
+			if (switched)
+				emit profilesChanged();
+			return;
+		}
+	}
+
+	// parented so QML never takes ownership of cards handed out by get()
+	auto c = std::make_unique<Card>(this);
+	c->update(info);
+	beginInsertRows(QModelIndex(), cards.size(), cards.size());
+	cards.push_back(std::move(c));
+	endInsertRows();
+	emit countChanged();
+}
+
+void CardModel::remove(uint32_t index) {
+	auto it = std::find_if(cards.begin(), cards.end(),
+			[index](const std::unique_ptr<Card>& c) { return c->index == index; });
+	if (it == cards.end())
+		return;
+
+	int row = it - cards.begin();
+	beginRemoveRows(QModelIndex(), row, row);
+	// QML may still hold a pointer to the card until it has seen the removal
+	it->release()->deleteLater();
+	cards.erase(it);
+	endRemoveRows();
+	emit countChanged();
+}
@@ -0,0 +1,170 @@
+#ifndef DEVICEMODELS_H
+#define DEVICEMODELS_H
+
+#include <QAbstractListModel>
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <pulse/pulseaudio.h>
+#include <string>
+#include <vector>
+// devicemodels.h: list models for sinks, cards and card profiles. they hold PAManager's device
+// lists and signal row level changes, so QML only touches the delegates that changed
+
+struct Profile {
+	std::string name;
+	std::string description;
+	bool active;
+	unsigned int sinks; // how many sinks the card has with this profile
+	bool operator==(const Profile& other) const;
+};
+
+// the percentage shown for a volume everywhere: its loudest channel, so it reads back what
+// setting every channel to that percentage wrote
+int volumePct(const pa_cvolume& volume);
+
+// plain copy of a pa_sink_info, safe to pass from the mainloop thread to the GUI thread
+struct SinkInfo {
+	std::string name;
+	std::string description; // user friendly name
+	uint32_t index;
+	pa_cvolume volume;
+	bool mute;
+	std::string monitor; // name of the sink's monitor source
+	// where the sink comes from, so it can be found again after a card profile change
+	uint32_t card;        // pulseaudio index of its card, PA_INVALID_INDEX if it has none
+	std::string alsaCard; // alsa.card, the same on the card itself
+	std::string profile;  // device.profile.name, the part of the card profile it belongs to
+};
+
+// plain copy of a pa_card_info, safe to pass from the mainloop thread to the GUI thread
+struct CardInfo {
+	std::string name;
+	uint32_t index;
+	std::string alsaCard;
+	QString description;
+	std::vector<Profile> profiles;
+	unsigned int activeProfileIndex;
+};
+
+class SinkModel : public QAbstractListModel {
+	Q_OBJECT
+	Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+  public:
+	enum Roles {
+		NameRole = Qt::UserRole + 1,
+		DescriptionRole,
+		VolumeRole,
+		MutedRole,
+	};
+
+	explicit SinkModel(QObject* parent = nullptr);
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex& index, int role) const override;
+	QHash<int, QByteArray> roleNames() const override;
+
+	const SinkInfo& at(int row) const;
+	// row of the sink with the given pulseaudio index or name, -1 if there is none
+	int rowOf(uint32_t index) const;
+	int rowOf(const std::string& name) const;
+
+	// new sinks are appended, so rows of the other sinks only move on removal
+	void update(const SinkInfo& info);
+	void remove(uint32_t index);
+
+  signals:
+	void countChanged();
+
+  private:
+	std::vector<SinkInfo> sinks;
+};
+
+class ProfileModel : public QAbstractListModel {
+	Q_OBJECT
+	Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+  public:
+	enum Roles {
+		NameRole = Qt::UserRole + 1,
+		DescriptionRole,
+		ActiveRole,
+	};
+
+	explicit ProfileModel(QObject* parent = nullptr);
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex& index, int role) const override;
+	QHash<int, QByteArray> roleNames() const override;
+
+	const std::vector<Profile>& list() const;
+	// turn the current profiles into newProfiles with as few row changes as possible
+	void update(const std::vector<Profile>& newProfiles);
+
+  signals:
+	void countChanged();
+
+  private:
+	std::vector<Profile> profiles;
+};
+
+class Card : public QObject {
+	Q_OBJECT
+	Q_PROPERTY(QString description MEMBER description NOTIFY descriptionChanged)
+	Q_PROPERTY(ProfileModel* profiles READ getProfiles CONSTANT)
+	Q_PROPERTY(int activeProfileIndex MEMBER activeProfileIndex NOTIFY activeProfileChanged)
+  public:
+	explicit Card(QObject* parent = nullptr);
+
+	std::string name; // alsa_card_XXXXX...
+	uint32_t index;
+	std::string alsaCard;
+	QString description;
+
+	unsigned int activeProfileIndex;
+	ProfileModel* getProfiles();
+	const std::vector<Profile>& availableProfiles() const;
+	Profile getActiveProfile() const;
+
+	// patch this card in place, only emitting for what actually changed
+	void update(const CardInfo& info);
+  signals:
+	void descriptionChanged();
+	void activeProfileChanged();
+
+  private:
+	ProfileModel profiles;
+};
+
+class CardModel : public QAbstractListModel {
+	Q_OBJECT
+	Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+  public:
+	enum Roles {
+		DescriptionRole = Qt::UserRole + 1,
+		CardRole,
+	};
+
+	explicit CardModel(QObject* parent = nullptr);
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex& index, int role) const override;
+	QHash<int, QByteArray> roleNames() const override;
+
+	Q_INVOKABLE Card* get(int row) const;
+	Card* find(uint32_t index) const;
+	Card* find(const std::string& name) const;
+
+	void update(const CardInfo& info);
+	void remove(uint32_t index);
+
+  signals:
+	void countChanged();
+	// a card's profiles or its active profile changed
+	void profilesChanged();
+
+  private:
+	// pointers because QObjects have no copy constructors
+	std::vector<std::unique_ptr<Card>> cards;
+};
+
+#endif // DEVICEMODELS_H
@@ -0,0 +1,243 @@
+#include "levelmeter.h"
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+// how much of the last shown level is kept per drain when nothing louder comes in
+constexpr qreal decay = 0.85;
+constexpr int drainInterval = 33; // ms
+
+// rate of the recorded stream. with peak detection the server sends one peak per frame
+constexpr uint32_t peakRate = 25;
+constexpr uint32_t rmsRate = 8000;
+} // namespace
+
+LevelMeter::LevelMeter(QObject* parent)
+	: QObject(parent), mainloop(nullptr), context(nullptr), stream(nullptr), sourceChannels(0),
+	  active(false), rmsMode(false) {
+	drainTimer.setInterval(drainInterval);
+	connect(&drainTimer, SIGNAL(timeout()), this, SLOT(drain()));
+}
+
+LevelMeter::~LevelMeter() { stopStream(); }
+
+void LevelMeter::attach(pa_threaded_mainloop* ml, pa_context* ctx) {
+	mainloop = ml;
+	context = ctx;
+	if (active)
+		startStream();
+}
+
+void LevelMeter::detach() {
+	stopStream();
+	mainloop = nullptr;
+	context = nullptr;
+}
+
+void LevelMeter::setSource(const std::string& name, int channels) {
+	if (name == sourceName && channels == sourceChannels)
+		return;
+
+	stopStream();
+	sourceName = name;
+	sourceChannels = channels;
+	if (active)
+		startStream();
+}
+
+void LevelMeter::setRms(bool enabled) {
+	if (enabled == rmsMode)
+		return;
+
+	stopStream();
+	rmsMode = enabled;
+	if (active)
+		startStream();
+}
+
+void LevelMeter::setActive(bool a) {
+	if (a == active)
+		return;
+
+	active = a;
+	if (active)
+		startStream();
+	else
+		stopStream();
+	emit activeChanged();
+}
+
+QList<qreal> LevelMeter::getPeaks() const { return peaks; }
+
+QList<qreal> LevelMeter::getRms() const { return rmsLevels; }
+
+bool LevelMeter::isActive() const { return active; }
+
+void LevelMeter::startStream() {
+	if (!context || stream || sourceName.empty() || sourceChannels < 1)
+		return;
+
+	pa_sample_spec ss;
+	ss.format = PA_SAMPLE_FLOAT32NE;
+	ss.rate = rmsMode ? rmsRate : peakRate;
+	ss.channels = std::min(sourceChannels, static_cast<int>(PA_CHANNELS_MAX));
+
+	// about one fragment per drain, so the server doesn't wake us up more often than that
+	pa_buffer_attr attr;
+	attr.maxlength = static_cast<uint32_t>(-1);
+	attr.fragsize = std::max(pa_usec_to_bytes(drainInterval * 1000, &ss), pa_frame_size(&ss));
+
+	auto flags = static_cast<pa_stream_flags_t>(PA_STREAM_DONT_MOVE | PA_STREAM_ADJUST_LATENCY
+												| PA_STREAM_DONT_INHIBIT_AUTO_SUSPEND
+												| (rmsMode ? 0 : PA_STREAM_PEAK_DETECT));
+
+	pa_threaded_mainloop_lock(mainloop);
+	stream = pa_stream_new(context, "Level meter", &ss, nullptr);
+	if (stream) {
+		pa_stream_set_read_callback(stream, &LevelMeter::readCallback, this);
+		if (pa_stream_connect_record(stream, sourceName.c_str(), &attr, flags) < 0) {
+			std::clog << "Could not record from " << sourceName << ": "
+					  << pa_strerror(pa_context_errno(context)) << std::endl;
+			pa_stream_unref(stream);
+			stream = nullptr;
+		}
+	}
+	pa_threaded_mainloop_unlock(mainloop);
+
+	if (stream)
+		drainTimer.start();
+}
+
+void LevelMeter::stopStream() {
+	drainTimer.stop();
+	if (stream) {
+		pa_threaded_mainloop_lock(mainloop);
+		pa_stream_set_read_callback(stream, nullptr, nullptr);
+		pa_stream_disconnect(stream);
+		pa_stream_unref(stream);
+		stream = nullptr;
+		pa_threaded_mainloop_unlock(mainloop);
+	}
+
+	// nothing writes to the ring anymore, throw away what's left
+	Level level;
+	while (ring.pop(level)) {}
+
+	if (!peaks.isEmpty() || !rmsLevels.isEmpty()) {
+		peaks.clear();
+		rmsLevels.clear();
+		emit levelsChanged();
+	}
+}
+
+void LevelMeter::readCallback(pa_stream* s, size_t, void* userdata) {
+	Trace::Span span("LevelMeter::readCallback");
+	auto self = static_cast<LevelMeter*>(userdata);
+	int channels = pa_stream_get_sample_spec(s)->channels;
+
+	while (pa_stream_readable_size(s) > 0) {
+		const void* data;
+		size_t nbytes;
+		if (pa_stream_peek(s, &data, &nbytes) < 0 || nbytes == 0)
+			return;
+
+		// data is null if there's a hole in the stream
+		if (data) {
+			Level level;
+			measure(static_cast<const float*>(data), nbytes / (sizeof(float) * channels), channels,
+					level);
+			// if the GUI fell behind this one is dropped, the next one will do
+			self->ring.push(level);
+		}
+		pa_stream_drop(s);
+	}
+}
+
+void LevelMeter::measure(const float* samples, size_t frames, int channels, Level& level) {
+	level.channels = std::min(channels, maxChannels);
+	float peak[maxChannels] = {};
+	float sum[maxChannels] = {};
+
+	size_t total = frames * channels;
+	size_t i = 0;
+#ifdef __SSE2__
+	// lane k of a vector always holds channel k % channels if 4 is a multiple of channels, which
+	// covers mono, stereo and quad
+	if (4 % channels == 0) {
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 vpeak = _mm_setzero_ps();
+		__m128 vsum = _mm_setzero_ps();
+		for (; i + 4 <= total; i += 4) {
+			__m128 x = _mm_and_ps(_mm_loadu_ps(samples + i), absMask);
+			vpeak = _mm_max_ps(vpeak, x);
+			vsum = _mm_add_ps(vsum, _mm_mul_ps(x, x));
+		}
+
+		float lanePeak[4], laneSum[4];
+		_mm_storeu_ps(lanePeak, vpeak);
+		_mm_storeu_ps(laneSum, vsum);
+		for (int k = 0; k < 4; k++) {
+			peak[k % channels] = std::max(peak[k % channels], lanePeak[k]);
+			sum[k % channels] += laneSum[k];
+		}
+	}
+#endif
+	for (; i < total; i++) {
+		int c = i % channels;
+		if (c >= maxChannels)
+			continue;
+		float x = std::fabs(samples[i]);
+		peak[c] = std::max(peak[c], x);
+		sum[c] += x * x;
+	}
+
+	for (int c = 0; c < level.channels; c++) {
+		level.peak[c] = peak[c];
+		level.rms[c] = frames ? std::sqrt(sum[c] / frames) : 0;
+	}
+}
+
+void LevelMeter::drain() {
+	// keep the loudest measurement since the last drain
+	Level latest, level;
+	bool got = false;
+	while (ring.pop(level)) {
+		if (!got) {
+			latest = level;
+			got = true;
+			continue;
+		}
+		for (int c = 0; c < latest.channels; c++) {
+			latest.peak[c] = std::max(latest.peak[c], level.peak[c]);
+			latest.rms[c] = std::max(latest.rms[c], level.rms[c]);
+		}
+	}
+
+	// levels fall off gradually, and settle on exactly 0 so a silent meter stops causing redraws
+	auto fall = [](qreal shown, float measured) {
+		qreal l = std::max<qreal>(shown * decay, measured);
+		return (l < 0.001) ? 0.0 : l;
+	};
+
+	int channels = got ? latest.channels : peaks.size();
+	QList<qreal> newPeaks, newRms;
+	for (int c = 0; c < channels; c++) {
+		newPeaks << fall((c < peaks.size()) ? peaks[c] : 0, got ? latest.peak[c] : 0);
+		if (rmsMode)
+			newRms << fall((c < rmsLevels.size()) ? rmsLevels[c] : 0, got ? latest.rms[c] : 0);
+	}
+
+	if (newPeaks == peaks && newRms == rmsLevels)
+		return;
+
+	peaks = newPeaks;
+	rmsLevels = newRms;
+	emit levelsChanged();
+}
@@ -0,0 +1,82 @@
+#ifndef LEVELMETER_H
+#define LEVELMETER_H
+
+#include "spscring.h"
+
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <pulse/pulseaudio.h>
+#include <string>
+// levelmeter.h: peak levels of the default sink, read from its monitor source
+
+class LevelMeter : public QObject {
+	Q_OBJECT
+	Q_PROPERTY(QList<qreal> peaks READ getPeaks NOTIFY levelsChanged)
+	Q_PROPERTY(QList<qreal> rms READ getRms NOTIFY levelsChanged)
+	Q_PROPERTY(bool active READ isActive NOTIFY activeChanged)
+  public:
+	static constexpr int maxChannels = 8;
+
+	// one measurement of every channel, made on the mainloop thread
+	struct Level {
+		int channels = 0;
+		float peak[maxChannels] = {};
+		float rms[maxChannels] = {};
+	};
+
+	explicit LevelMeter(QObject* parent = nullptr);
+	~LevelMeter();
+
+	// the meter records through PAManager's context. detach() before that goes away
+	void attach(pa_threaded_mainloop* ml, pa_context* ctx);
+	void detach();
+
+	// monitor source of the sink to measure and its channel count. restarts the stream if it
+	// is running
+	void setSource(const std::string& name, int channels);
+
+	// by default the server measures peaks and only sends those at a low rate. with rms enabled,
+	// raw samples are recorded and measured here, which also gives per channel rms
+	void setRms(bool enabled);
+
+	// peak and rms of each channel over interleaved float samples
+	static void measure(const float* samples, size_t frames, int channels, Level& level);
+
+	QList<qreal> getPeaks() const;
+	QList<qreal> getRms() const;
+	bool isActive() const;
+
+  public slots:
+	// the stream only exists while active, so an unseen meter costs nothing
+	void setActive(bool active);
+
+  signals:
+	void levelsChanged();
+	void activeChanged();
+
+  private slots:
+	void drain();
+
+  private:
+	pa_threaded_mainloop* mainloop;
+	pa_context* context;
+	pa_stream* stream;
+
+	std::string sourceName;
+	int sourceChannels;
+	bool active;
+	bool rmsMode;
+
+	// filled by the read callback, drained by drainTimer
+	SpscRing<Level, 64> ring;
+	QTimer drainTimer;
+	QList<qreal> peaks;
+	QList<qreal> rmsLevels;
+
+	void startStream();
+	void stopStream();
+	static void readCallback(pa_stream* s, size_t nbytes, void* userdata);
+};
+
+#endif // LEVELMETER_H
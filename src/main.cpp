@@ -1,23 +1,77 @@
+#include "cli.h"
+#include "controlserver.h"
 #include "openvr.h"
 #include "pamanager.h"
+#include "stats.h"
+#include "strs.h"
+#include "trace.h"
 #include "vrmanager.h"
 
 #include <QCommandLineParser>
+#include <QCoreApplication>
 #include <QGuiApplication>
 #include <QQuickRenderControl>
 #include <QVulkanInstance>
 #include <QtQuick>
 #include <iostream>
+#include <memory>
 
 using namespace vr;
+
+namespace {
+// one set of options for both modes
+void addOptions(QCommandLineParser& parser) {
+	parser.setApplicationDescription("VR Audio Controls for Linux");
+	parser.addHelpOption();
+	parser.addOption({"uninstall", "Uninstalls the manifest from Steam."});
+	parser.addOption({"always-render", "Render every frame, even if nothing changed."});
+	parser.addOption({"hidden-interval", "Event poll interval while the overlay is hidden.", "ms",
+			"200"});
+	parser.addOption({"idle-interval", "Frame interval while the overlay is shown.", "ms", "33"});
+	parser.addOption({"active-interval", "Frame interval while the overlay is being used.", "ms",
+			"11"});
+	parser.addOption({"overlay-size", "Size of the overlay's layout.", "WxH", "2100x1200"});
+	parser.addOption({"overlay-scale", "Texture pixels per layout unit, lower is cheaper to "
+									   "render but blurrier.", "scale", "1.0"});
+	parser.addOption({"texture-bounds", "Keep the texture at full size and crop it to the "
+										"scaled frame instead of reallocating it."});
+	parser.addOption({"render-thread", "Render and submit frames on a thread of their own, so a "
+									   "busy GUI thread can't hold them back."});
+	parser.addOption({"wrist", "Also show a small volume and mute overlay on the wrist of the "
+							   "left or right controller.", "hand"});
+	parser.addOption({"meter-rms", "Measure per channel RMS levels in vrdio instead of only "
+								   "reading peaks from the server."});
+	parser.addOption({"stats", "Collect timings of the render loop and audio operations and "
+							   "write them to ~/.config/vrdio/stats.json."});
+	parser.addOption({"stats-interval", "How often --stats writes its file.", "s", "10"});
+	parser.addOption({"stats-hud", "Also show a summary of --stats in the overlay."});
+	parser.addOption({"no-control-socket", "Don't let other programs control vrdio through "
+										   "$XDG_RUNTIME_DIR/vrdio.sock."});
+	parser.addOption({"trace", "Record a timeline of the render loop and audio callbacks and "
+							   "write it to ~/.config/vrdio/trace.json on exit, for "
+							   "chrome://tracing or ui.perfetto.dev."});
+	Cli::addOptions(parser);
+}
+} // namespace
+
 int main(int argc, char* argv[]) {
+	qint64 launched = Stats::now();
+	// the command line tools only talk to pulseaudio, so they skip the GUI, OpenVR and vulkan
+	if (Cli::requested(argc, argv)) {
+		QCoreApplication a(argc, argv);
+		// the overlay's options are accepted and ignored, so a command can be added to any
+		// launch line
+		QCommandLineParser parser;
+		addOptions(parser);
+		parser.process(a);
+		return Cli::run(parser);
+	}
+
 	QQuickWindow::setGraphicsApi(QSGRendererInterface::Vulkan);
 	QGuiApplication a(argc, argv);
 
 	QCommandLineParser parser;
-	parser.setApplicationDescription("VR Audio Controls for Linux");
-	parser.addHelpOption();
-	parser.addOption({"uninstall", "Uninstalls the manifest from Steam."});
+	addOptions(parser);
 	parser.process(a);
 
 	if (parser.isSet("uninstall")) {
@@ -25,27 +79,148 @@ int main(int argc, char* argv[]) {
 		return 0;
 	}
 
+	// made first, so it's still there for the final dump
+	Stats stats;
+	// before anything that starts a thread, so every thread is on the timeline
+	if (parser.isSet("trace"))
+		Trace::enable(strings::trace_loc);
+
 	QQuickRenderControl renderCtrl;
 	QQuickView w(QUrl(), &renderCtrl);
 	QVulkanInstance instance;
+	// the wrist overlay's own scene, if any
+	std::unique_ptr<QQuickRenderControl> wristCtrl;
+	std::unique_ptr<QQuickView> wristView;
+
+	// setup pulseaudio first. it connects and fetches the sinks on its own thread while OpenVR
+	// and vulkan are set up below
+	PAManager pulse("VR Audio Control");
+	pulse.getMeter()->setRms(parser.isSet("meter-rms"));
 
 	// setup vulkan
+	qint64 vrStart = Stats::now();
 	VRManager ctrl(&w, &renderCtrl);
+	Stats::recordOnce("vrInit", Stats::now() - vrStart);
+	ctrl.setDamageTracking(!parser.isSet("always-render"));
+	if (parser.isSet("render-thread"))
+		ctrl.startRenderThread();
 
-	// setup pulseaudio
-	PAManager pulse("VR Audio Control");
+	// keep the defaults for anything that isn't a positive number
+	auto readInterval = [&parser](const QString& name, int& interval) {
+		bool ok = false;
+		int value = parser.value(name).toInt(&ok);
+		if (ok && value > 0)
+			interval = value;
+		else
+			std::clog << "Ignoring invalid --" << name.toStdString() << std::endl;
+	};
+	VRManager::FrameIntervals intervals;
+	readInterval("hidden-interval", intervals.hidden);
+	readInterval("idle-interval", intervals.idle);
+	readInterval("active-interval", intervals.active);
+	ctrl.setFrameIntervals(intervals);
+
+	VRManager::OverlaySize size;
+	const QStringList dims = parser.value("overlay-size").split('x');
+	const int width = dims.value(0).toInt(), height = dims.value(1).toInt();
+	if (dims.size() == 2 && width > 0 && height > 0) {
+		size.width = width;
+		size.height = height;
+	} else {
+		std::clog << "Ignoring invalid --overlay-size" << std::endl;
+	}
+	bool scaleOk = false;
+	qreal scale = parser.value("overlay-scale").toDouble(&scaleOk);
+	if (scaleOk && scale >= VRManager::minScale && scale <= VRManager::maxScale)
+		size.scale = scale;
+	else
+		std::clog << "Ignoring invalid --overlay-scale" << std::endl;
+	size.textureBounds = parser.isSet("texture-bounds");
+	ctrl.setOverlaySize(size);
+
+	if (parser.isSet("wrist")) {
+		const QString hand = parser.value("wrist");
+		if (hand == "left" || hand == "right") {
+			wristCtrl = std::make_unique<QQuickRenderControl>();
+			wristView = std::make_unique<QQuickView>(QUrl(), wristCtrl.get());
+			ctrl.addWristOverlay(wristView.get(), wristCtrl.get(),
+					hand == "left" ? VRManager::Hand::Left : VRManager::Hand::Right);
+		} else {
+			std::clog << "Ignoring invalid --wrist, expected left or right" << std::endl;
+		}
+	}
+
+	// external tools share pulse with the overlay
+	ControlServer control(&pulse);
+	if (!parser.isSet("no-control-socket"))
+		control.listen(strings::control_socket_loc);
+
+	// the level meter only records while the overlay can be seen
+	QObject::connect(
+			&ctrl, SIGNAL(visibilityChanged(bool)), pulse.getMeter(), SLOT(setActive(bool)));
+	// and nobody needs the cards before it's opened for the first time
+	QObject::connect(&ctrl, SIGNAL(visibilityChanged(bool)), &pulse, SLOT(loadCards()),
+			Qt::SingleShotConnection);
+
+	if (parser.isSet("stats") || parser.isSet("stats-hud")) {
+		int interval = 10;
+		readInterval("stats-interval", interval);
+		stats.addSource("frames", [&ctrl] {
+			const VRManager::FrameStats& f = ctrl.frameStats();
+			return QJsonObject{
+					{"rendered", qint64(f.rendered)},
+					{"skipped", qint64(f.skipped)},
+					{"intervalMs", f.interval},
+					{"lastSubmitUs", f.submitNs / 1000.0},
+					{"inputEvents", qint64(f.inputEvents)},
+					{"inputDispatched", qint64(f.inputDispatched)},
+			};
+		});
+		stats.addSource("memory", [&ctrl] {
+			VkAllocator::Usage usage = ctrl.memoryUsage();
+			return QJsonObject{
+					{"reservedMiB", usage.reserved / double(1 << 20)},
+					{"usedMiB", usage.used / double(1 << 20)},
+					{"blocks", usage.blocks},
+					{"dedicated", usage.dedicated},
+			};
+		});
+		stats.addSource("audio", [&pulse] {
+			AudioMirror* mirror = pulse.getMirror();
+			return QJsonObject{
+					{"pendingOperations", pulse.getPendingOperations()},
+					{"droppedVolumeOps", pulse.getDroppedVolumeOps()},
+					{"mirrorUnderruns", mirror->getUnderruns()},
+					{"mirrorOverruns", mirror->getOverruns()},
+					{"mirrorDriftPpm", mirror->getDriftPpm()},
+			};
+		});
+		stats.enable(strings::stats_loc, interval * 1000, parser.isSet("stats-hud"));
+	}
 
 	// expose PAManager to QML
 	// have to call setContextProperty before setting source, otherwise you get
 	// annoying errors
 	w.rootContext()->setContextProperty("pulse", &pulse);
+	w.rootContext()->setContextProperty("stats", &stats);
 	w.setSource(QUrl("qrc:///main.qml"));
 
-	if (!renderCtrl.initialize()) {
+	if (!ctrl.initializeScene(&renderCtrl)) {
 		throw std::runtime_error("Failed to initialize QQuickRenderControl!");
 	}
 
+	if (wristView) {
+		wristView->rootContext()->setContextProperty("pulse", &pulse);
+		wristView->setSource(QUrl("qrc:///WristControl.qml"));
+		if (!ctrl.initializeScene(wristCtrl.get()))
+			throw std::runtime_error("Failed to initialize the wrist QQuickRenderControl!");
+	}
+
 	ctrl.buildOverlay();
+	Stats::recordOnce("startup", Stats::now() - launched);
 
-	return a.exec();
+	int ret = a.exec();
+	if (Trace::enabled())
+		Trace::write();
+	return ret;
 }
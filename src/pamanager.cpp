@@ -1,353 +1,958 @@
 #include "pamanager.h"
 
+#include "stats.h"
 #include "strs.h"
+#include "trace.h"
 
 #include <QDir>
 #include <QFile>
+#include <QJsonArray>
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <pulse/pulseaudio.h>
 #include <vector>
 
-void PAManager::waitForContext(pa_context* c, void* userdata) {
-	if (pa_context_get_state(c) != PA_CONTEXT_READY)
-		return;
-
-	// send signal that context is ready and mainloop can stop waiting
-	pa_threaded_mainloop_signal(static_cast<pa_threaded_mainloop*>(userdata), 0);
+namespace {
+bool sinkOnCard(const SinkInfo& sink, uint32_t card, const std::string& alsaCard) {
+	return sink.card == card || (!alsaCard.empty() && sink.alsaCard == alsaCard);
 }
-PAManager::PAManager(const char* appName)
-	: mainloop(nullptr), context(nullptr), defaultSinkIndex(-1) {
+} // namespace
+
+PAManager::PAManager(const char* appName, bool restore)
+	: sinks(this), cards(this), streams(this), meter(this), mirror(this), mainloop(nullptr),
+	  context(nullptr), defaultSinkIndex(-1), createdNs(Stats::now()), ready(false),
+	  droppedVolumeOps(0) {
 	// create mainloop
 	mainloop = pa_threaded_mainloop_new();
+	pa_threaded_mainloop_set_name(mainloop, "vrdio-pulse");
+	if (restore)
+		rules = RulesEngine::load(strings::rules_loc);
+
+	profileSwitchTimer.setSingleShot(true);
+	connect(&profileSwitchTimer, SIGNAL(timeout()), this, SLOT(checkProfileSwitches()));
 
 	// create context
 	pa_mainloop_api* api = pa_threaded_mainloop_get_api(mainloop);
 	context = pa_context_new(api, appName);
 
-	// set context callback. used to escape wait loop below
-	// mainloop passed as userdata for signalling
-	pa_context_set_state_callback(context, &PAManager::waitForContext, mainloop);
-
-	// connect to context
-	pa_context_connect(context, nullptr, PA_CONTEXT_NOFLAGS, nullptr);
+	// nothing here waits for the server. contextStateCallback sends the initial requests once
+	// it's connected, while the rest of vrdio starts up
+	pa_context_set_state_callback(context, &PAManager::contextStateCallback, this);
+	if (pa_context_connect(context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0)
+		std::cerr << "Could not connect to PulseAudio: " << pa_strerror(pa_context_errno(context))
+				  << std::endl;
 
 	// start the mainloop
 	pa_threaded_mainloop_start(mainloop);
 
+	if (restore) {
+		mirror.loadConfig();
+		loadConfig();
+	}
+	presets = Preset::load(strings::presets_loc);
+}
+
+void PAManager::contextStateCallback(pa_context* c, void* userdata) {
+	Trace::Span span("PAManager::contextStateCallback");
+	auto self = static_cast<PAManager*>(userdata);
+	pa_context_state_t state = pa_context_get_state(c);
+	if (state == PA_CONTEXT_FAILED || state == PA_CONTEXT_TERMINATED) {
+		if (state == PA_CONTEXT_FAILED)
+			std::cerr << "Lost connection to PulseAudio: " << pa_strerror(pa_context_errno(c))
+					  << std::endl;
+		for (auto& f : self->deferred)
+			f(false);
+		self->deferred.clear();
+		return;
+	}
+	if (state != PA_CONTEXT_READY)
+		return;
+
+	Stats::recordOnce("pulseConnect", Stats::now() - self->createdNs);
+
+	// listen for sink, card, stream and server changes, so the lists only ever get patched in
+	// place
+	pa_context_set_subscribe_callback(c, &PAManager::subscribeCallback, self);
+	pa_operation* o = pa_context_subscribe(c,
+			static_cast<pa_subscription_mask_t>(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_CARD
+												| PA_SUBSCRIPTION_MASK_SINK_INPUT
+												| PA_SUBSCRIPTION_MASK_SERVER),
+			nullptr, nullptr);
+	if (o)
+		pa_operation_unref(o);
+
+	// the server answers in order, so all sinks are in by the time the server info arrives
+	o = pa_context_get_sink_info_list(c, &PAManager::sinkInfoCallback, self);
+	if (o)
+		pa_operation_unref(o);
+	o = pa_context_get_server_info(c, &PAManager::startupServerInfoCallback, self);
+	if (o)
+		pa_operation_unref(o);
+
+	// streams that already exist. nothing waits on these, they trickle into the model
+	o = pa_context_get_sink_input_info_list(c, &PAManager::sinkInputInfoCallback, self);
+	if (o)
+		pa_operation_unref(o);
+
+	for (auto& f : self->deferred)
+		f(true);
+	self->deferred.clear();
+}
+
+void PAManager::startupServerInfoCallback(
+		pa_context* c, const pa_server_info* info, void* userdata) {
+	auto self = static_cast<PAManager*>(userdata);
+	serverInfoCallback(c, info, userdata);
+	Stats::recordOnce("pulseIntrospection", Stats::now() - self->createdNs);
+	QMetaObject::invokeMethod(self, [self] { self->finishStartup(); }, Qt::QueuedConnection);
+}
+
+void PAManager::finishStartup() {
+	ready = true;
+	meter.attach(mainloop, context);
+	Stats::recordOnce("pulseReady", Stats::now() - createdNs);
+	emit readyChanged();
+}
+
+bool PAManager::isReady() const { return ready; }
+
+void PAManager::whenConnected(std::function<void(bool)> f) {
 	pa_threaded_mainloop_lock(mainloop);
-	// wait for context to be ready
-	while (pa_context_get_state(context) != PA_CONTEXT_READY)
-		pa_threaded_mainloop_wait(mainloop);
+	pa_context_state_t state = pa_context_get_state(context);
+	if (state == PA_CONTEXT_READY || !PA_CONTEXT_IS_GOOD(state))
+		f(state == PA_CONTEXT_READY);
+	else
+		deferred.push_back(std::move(f));
 	pa_threaded_mainloop_unlock(mainloop);
-
-	loadConfig();
-	buildSinkList();
-	getDefaultSink();
-	buildCardList();
 }
 
 PAManager::~PAManager() {
+	meter.detach();
+
+	pa_threaded_mainloop_lock(mainloop);
+	pa_context_set_subscribe_callback(context, nullptr, nullptr);
 	pa_context_disconnect(context);
+	pa_threaded_mainloop_unlock(mainloop);
 	pa_threaded_mainloop_stop(mainloop);
+	pa_context_unref(context);
 	pa_threaded_mainloop_free(mainloop);
+
+	// the server will never answer these now
+	for (ProfileSwitch* sw : profileSwitches)
+		delete sw;
+	for (PendingOp* op : pendingOps) {
+		op->promise.addResult(false);
+		op->promise.finish();
+		delete op;
+	}
+}
+
+PAManager::PendingOp* PAManager::beginOp(const QString& kind) {
+	auto op = new PendingOp{this, kind, {}, Stats::enabled() ? Stats::now() : 0};
+	op->promise.start();
+	pendingOps.push_back(op);
+	emit pendingOperationsChanged();
+	return op;
+}
+
+QFuture<bool> PAManager::trackOp(PendingOp* op, pa_operation* o) {
+	QFuture<bool> future = op->promise.future();
+	if (o)
+		pa_operation_unref(o);
+	else
+		finishOp(op, false);
+	return future;
+}
+
+void PAManager::finishOp(PendingOp* op, bool success) {
+	// usually called from the mainloop thread, resolve on the GUI thread
+	QMetaObject::invokeMethod(
+			this,
+			[this, op, success] {
+				Trace::Span span("PAManager::finishOp");
+				pendingOps.erase(std::find(pendingOps.begin(), pendingOps.end(), op));
+				if (op->startNs && Stats::enabled())
+					Stats::instance()->recordOp(op->kind, Stats::now() - op->startNs);
+				op->promise.addResult(success);
+				op->promise.finish();
+				emit pendingOperationsChanged();
+				emit operationFinished(op->kind, success);
+				delete op;
+			},
+			Qt::QueuedConnection);
+}
+
+void PAManager::opCallback(pa_context*, int success, void* userdata) {
+	Trace::Span span("PAManager::opCallback");
+	auto op = static_cast<PendingOp*>(userdata);
+	op->manager->finishOp(op, success);
 }
 
-void PAManager::waitForOpFinish(pa_operation* o) {
+int PAManager::getPendingOperations() const { return pendingOps.size(); }
+
+qint64 PAManager::getDroppedVolumeOps() const { return droppedVolumeOps; }
+
+QFuture<bool> PAManager::queueVolume(
+		VolumeTarget target, uint32_t index, const pa_cvolume& volume, PendingOp* op) {
+	QFuture<bool> future = op->promise.future();
+	VolumeSlot& slot = volumeSlots[{target, index}];
+	if (!slot.inFlight) {
+		sendVolume(target, index, volume, {op});
+		return future;
+	}
+
+	// latest wins: whatever was queued before is never sent
+	if (slot.queued) {
+		droppedVolumeOps++;
+		emit droppedVolumeOpsChanged();
+	}
+	slot.queued = true;
+	slot.volume = volume;
+	slot.waiting.push_back(op);
+	return future;
+}
+
+void PAManager::sendVolume(VolumeTarget target, uint32_t index, const pa_cvolume& volume,
+		std::vector<PendingOp*> ops) {
+	volumeSlots[{target, index}].inFlight = true;
+	auto send = new VolumeSend{this, target, index, std::move(ops)};
+
 	pa_threaded_mainloop_lock(mainloop);
-	while (pa_operation_get_state(o) == PA_OPERATION_RUNNING)
-		pa_threaded_mainloop_wait(mainloop);
+	pa_operation* o = (target == VolumeTarget::Sink)
+			? pa_context_set_sink_volume_by_index(
+					  context, index, &volume, &PAManager::volumeCallback, send)
+			: pa_context_set_sink_input_volume(
+					  context, index, &volume, &PAManager::volumeCallback, send);
 	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(o);
+
+	if (o)
+		pa_operation_unref(o);
+	else
+		volumeSent(send, false);
+}
+
+void PAManager::volumeCallback(pa_context*, int success, void* userdata) {
+	Trace::Span span("PAManager::volumeCallback");
+	auto send = static_cast<VolumeSend*>(userdata);
+	PAManager* self = send->manager;
+	QMetaObject::invokeMethod(
+			self, [self, send, success] { self->volumeSent(send, success); },
+			Qt::QueuedConnection);
+}
+
+// GUI thread. sends whatever queued up while this one was in flight
+void PAManager::volumeSent(VolumeSend* send, bool success) {
+	for (PendingOp* op : send->ops)
+		finishOp(op, success);
+
+	auto it = volumeSlots.find({send->target, send->index});
+	if (it != volumeSlots.end()) {
+		VolumeSlot& slot = it->second;
+		if (slot.queued) {
+			std::vector<PendingOp*> waiting = std::move(slot.waiting);
+			slot.waiting.clear();
+			slot.queued = false;
+			sendVolume(send->target, send->index, slot.volume, std::move(waiting));
+		} else {
+			volumeSlots.erase(it);
+		}
+	}
+	delete send;
 }
 
 // change the volume. newPct is a percentage
-void PAManager::changeVol(int newPct) {
+QFuture<bool> PAManager::changeVol(int newPct) {
+	Trace::Span span("PAManager::changeVol");
+	return changeSinkVolume(defaultSinkIndex, newPct);
+}
+
+QFuture<bool> PAManager::changeSinkVolume(int row, int newPct) {
+	PendingOp* op = beginOp("volume");
+	if (row == -1)
+		return trackOp(op, nullptr);
+
+	SinkInfo sink = sinks.at(row);
 	int newVol = PA_VOLUME_NORM * ((double)newPct / 100);
-	pa_cvolume_set(&(sinkList[defaultSinkIndex].volume), sinkList[defaultSinkIndex].volume.channels,
-			newVol);
-	pa_operation* o = pa_context_set_sink_volume_by_index(context, sinkList[defaultSinkIndex].index,
-			&(sinkList[defaultSinkIndex].volume), nullptr, nullptr);
-	pa_operation_unref(o);
+	// shown right away, the subscription confirms it
+	pa_cvolume_set(&sink.volume, sink.volume.channels, newVol);
+	updateSink(sink);
+	return queueVolume(VolumeTarget::Sink, sink.index, sink.volume, op);
+}
+
+QFuture<bool> PAManager::setMute(bool mute) {
+	Trace::Span span("PAManager::setMute");
+	return muteSink(defaultSinkIndex, mute);
+}
+
+QFuture<bool> PAManager::muteSink(int row, bool mute) {
+	PendingOp* op = beginOp("mute");
+	if (row == -1)
+		return trackOp(op, nullptr);
+
+	// shown right away, the subscription confirms it
+	SinkInfo sink = sinks.at(row);
+	sink.mute = mute;
+	updateSink(sink);
+
+	pa_threaded_mainloop_lock(mainloop);
+	pa_operation* o = pa_context_set_sink_mute_by_index(
+			context, sink.index, mute, &PAManager::opCallback, op);
+	pa_threaded_mainloop_unlock(mainloop);
+	return trackOp(op, o);
 }
 
 // return volume of the default sink as a percentage (0 - 100)
-int PAManager::getVolPct() {
+// the sink list is kept up to date by the subscription, so this never has to ask the server
+int PAManager::getVolPct() const {
+	Trace::Span span("PAManager::getVolPct");
 	if (defaultSinkIndex == -1)
 		return 0;
 
-	// update sink volume
-	struct cbStruct {
-		std::vector<Sink>& sink_list;
-		int& def_index;
-		pa_threaded_mainloop* mainloop;
-	};
+	return volumePct(sinks.at(defaultSinkIndex).volume);
+}
 
-	cbStruct s = {sinkList, defaultSinkIndex, mainloop};
+bool PAManager::isMuted() const {
+	Trace::Span span("PAManager::isMuted");
+	if (defaultSinkIndex == -1)
+		return false;
 
-	auto callback = [](pa_context*, const pa_sink_info* sink, int eol, void* data) {
-		auto items = static_cast<cbStruct*>(data);
-		if (eol) {
-			pa_threaded_mainloop_signal(items->mainloop, 0);
-			return;
-		}
-		items->sink_list[items->def_index].volume = sink->volume;
-	};
+	return sinks.at(defaultSinkIndex).mute;
+}
 
-	pa_operation* o = pa_context_get_sink_info_by_name(
-			context, sinkList[defaultSinkIndex].name.c_str(), callback, static_cast<void*>(&s));
-	waitForOpFinish(o);
+// sinks is only ever modified on the GUI thread, so no need to lock the mainloop
+SinkModel* PAManager::getSinks() { return &sinks; }
 
-	return ceil(((double)sinkList[defaultSinkIndex].volume.values[0] / PA_VOLUME_NORM) * 100);
-}
+QFuture<bool> PAManager::changeSink(int sinkIndex) {
+	Trace::Span span("PAManager::changeSink");
+	PendingOp* op = beginOp("sink");
+	if (sinkIndex < 0 || sinkIndex >= sinks.rowCount())
+		return trackOp(op, nullptr);
 
-// get sink names into qml
-QStringList PAManager::getSinkList() {
 	pa_threaded_mainloop_lock(mainloop);
-	QStringList list;
-	for (const auto& sink : sinkList) {
-		list << sink.description.c_str();
-	}
+	pa_operation* o = pa_context_set_default_sink(
+			context, sinks.at(sinkIndex).name.c_str(), &PAManager::opCallback, op);
 	pa_threaded_mainloop_unlock(mainloop);
-	return list;
-}
 
-void PAManager::changeSink(int sinkIndex) {
-	pa_operation* op = pa_context_set_default_sink(
-			context, sinkList[sinkIndex].name.c_str(), nullptr, nullptr);
-	pa_operation_unref(op);
 	defaultSinkIndex = sinkIndex;
+	defaultSinkName = sinks.at(sinkIndex).name;
+	updateMonitors();
 	emit newDefaultSink();
+	emit volumeChanged();
+	emit muteChanged();
+	return trackOp(op, o);
 }
 
 int PAManager::getDefaultSinkIndex() const { return defaultSinkIndex; }
 // get card names into qml
-QVariantList PAManager::getCardList() {
-	// pa_threaded_mainloop_lock(mainloop);
-	QVariantList list;
-	for (const auto& card : cardList)
-		list << QVariant::fromValue(card.get());
+CardModel* PAManager::getCards() { return &cards; }
+
+QFuture<bool> PAManager::changeCardProfile(Card* card, const QString& profileName) {
+	Trace::Span span("PAManager::changeCardProfile");
+	const std::vector<Profile>& profiles = card->availableProfiles();
+	auto profile = std::find_if(profiles.begin(), profiles.end(),
+			[&](const Profile& p) { return p.description == profileName.toStdString(); });
+	return switchCardProfile(card, profile == profiles.end() ? -1 : profile - profiles.begin());
+}
 
-	// pa_threaded_mainloop_unlock(mainloop);
-	return list;
+QFuture<bool> PAManager::changeCardProfileByName(Card* card, const std::string& name) {
+	Trace::Span span("PAManager::changeCardProfileByName");
+	const std::vector<Profile>& profiles = card->availableProfiles();
+	auto profile = std::find_if(profiles.begin(), profiles.end(),
+			[&name](const Profile& p) { return p.name == name; });
+	return switchCardProfile(card, profile == profiles.end() ? -1 : profile - profiles.begin());
 }
 
-void PAManager::changeCardProfile(Card* card, const QString& profileName) {
-	pa_threaded_mainloop_lock(mainloop);
+QFuture<bool> PAManager::switchCardProfile(Card* card, int profile) {
+	PendingOp* op = beginOp("profile");
+	QFuture<bool> future = op->promise.future();
+	auto sw = new ProfileSwitch{this, op, card->index, card->alsaCard, card->name};
+	profileSwitches.push_back(sw);
+	if (profile == -1) {
+		finishProfileSwitch(sw, false);
+		return future;
+	}
+
+	sw->profileName = card->availableProfiles()[profile].name;
+	sw->profileSinks = card->availableProfiles()[profile].sinks;
+	card->activeProfileIndex = profile;
+
+	// PipeWire likes to change the default sink after changing a card. keep it if it's on
+	// another card, otherwise it's going away and one of the card's new sinks replaces it
+	if (defaultSinkIndex != -1) {
+		const SinkInfo& current = sinks.at(defaultSinkIndex);
+		if (!sinkOnCard(current, card->index, card->alsaCard))
+			sw->sinkName = current.name;
+	}
+
+	sendProfileSwitch(sw);
+	return future;
+}
+
+// the rest of the switch happens as the server reports back, see checkProfileSwitches()
+void PAManager::sendProfileSwitch(ProfileSwitch* sw) {
+	whenConnected([this, sw](bool connected) {
+		pa_operation* o = nullptr;
+		if (connected)
+			o = pa_context_set_card_profile_by_name(context, sw->cardName.c_str(),
+					sw->profileName.c_str(), &PAManager::profileSetCallback, sw);
+		if (o)
+			pa_operation_unref(o);
+		else
+			QMetaObject::invokeMethod(
+					this, [this, sw] { profileApplied(sw, false); }, Qt::QueuedConnection);
+	});
+}
+
+void PAManager::profileSetCallback(pa_context*, int success, void* userdata) {
+	Trace::Span span("PAManager::profileSetCallback");
+	auto sw = static_cast<ProfileSwitch*>(userdata);
+	PAManager* self = sw->manager;
+	QMetaObject::invokeMethod(
+			self, [self, sw, success] { self->profileApplied(sw, success); },
+			Qt::QueuedConnection);
+}
+
+void PAManager::profileApplied(ProfileSwitch* sw, bool success) {
+	if (!success) {
+		std::cout << "Failed to switch to profile " << sw->profileName << std::endl;
+		finishProfileSwitch(sw, false);
+		return;
+	}
+
+	// profiles like off have no sinks, there's nothing to wait for
+	if (sw->keepDefault || (sw->sinkName.empty() && sw->profileSinks == 0)) {
+		finishProfileSwitch(sw, true);
+		return;
+	}
+
+	sw->applied = true;
+	sw->deadline.setRemainingTime(profileSwitchTimeoutMs);
+	checkProfileSwitches();
+}
+
+bool PAManager::switchWants(const ProfileSwitch& sw, const SinkInfo& sink) {
+	if (!sw.sinkName.empty())
+		return sink.name == sw.sinkName;
+	if (!sinkOnCard(sink, sw.card, sw.alsaCard))
+		return false;
+
+	// alsa card profiles combine mappings, like output:analog-stereo+input:analog-stereo, and
+	// each sink names the output mapping it comes from in device.profile.name
+	bool mapped = false;
+	for (const QString& part : QString::fromStdString(sw.profileName).split('+')) {
+		if (!part.startsWith("output:"))
+			continue;
+		mapped = true;
+		if (!sink.profile.empty() && part.mid(7).toStdString() == sink.profile)
+			return true;
+	}
+	// other cards, e.g. bluetooth ones, have a single sink per profile that names none. a sink
+	// of an alsa profile without a name could be the one from before the switch
+	return !mapped && sink.profile.empty();
+}
 
-	std::string oldSinkName = sinkList[defaultSinkIndex].name;
+void PAManager::checkProfileSwitches() {
+	if (profileSwitches.empty())
+		return;
 
-	std::string profile_name{};
-	for (int i = 0; i < card->availableProfiles.size(); i++) {
-		const auto& profile = card->availableProfiles[i];
-		if (profile.description == profileName.toStdString()) {
-			profile_name = profile.name;
-			card->activeProfileIndex = i;
-			break;
+	qint64 next = -1; // ms until the next deadline
+	for (ProfileSwitch* sw : std::vector<ProfileSwitch*>(profileSwitches)) {
+		if (!sw->applied)
+			continue;
+
+		// the server may already have made the right sink the default
+		int row = -1;
+		if (defaultSinkIndex != -1 && switchWants(*sw, sinks.at(defaultSinkIndex)))
+			row = defaultSinkIndex;
+		for (int i = 0; i < sinks.rowCount() && row == -1; i++) {
+			if (switchWants(*sw, sinks.at(i)))
+				row = i;
+		}
+
+		if (row != -1) {
+			const std::string& name = sinks.at(row).name;
+			std::cout << "Switching to sink " << name << std::endl;
+			if (sw->volume >= 0)
+				changeSinkVolume(row, sw->volume);
+			profileSwitches.erase(std::find(profileSwitches.begin(), profileSwitches.end(), sw));
+			// a sink that was kept gets set again, in case the server moved away from it
+			if (row == defaultSinkIndex && sw->sinkName.empty()) {
+				finishOp(sw->op, true);
+			} else {
+				pa_threaded_mainloop_lock(mainloop);
+				pa_operation* o = pa_context_set_default_sink(
+						context, name.c_str(), &PAManager::opCallback, sw->op);
+				pa_threaded_mainloop_unlock(mainloop);
+				trackOp(sw->op, o);
+			}
+			delete sw;
+		} else if (sw->deadline.hasExpired()) {
+			std::cout << "No sink showed up for profile " << sw->profileName << std::endl;
+			finishProfileSwitch(sw, false);
+		} else {
+			qint64 remaining = sw->deadline.remainingTime();
+			next = (next == -1) ? remaining : std::min(next, remaining);
 		}
 	}
 
-	auto callback = [](pa_context*, int success, void* data) {
-		auto ml = static_cast<pa_threaded_mainloop*>(data);
-		if (!success)
-			std::cout << "Failed to switch to profile." << std::endl;
-		pa_threaded_mainloop_signal(ml, 0);
-	};
+	if (next == -1)
+		profileSwitchTimer.stop();
+	else
+		profileSwitchTimer.start(next);
+}
 
-	pa_operation* o = pa_context_set_card_profile_by_index(
-			context, card->index, profile_name.c_str(), callback, mainloop);
-	pa_threaded_mainloop_unlock(mainloop);
+void PAManager::finishProfileSwitch(ProfileSwitch* sw, bool success) {
+	profileSwitches.erase(std::find(profileSwitches.begin(), profileSwitches.end(), sw));
+	finishOp(sw->op, success);
+	delete sw;
+}
 
-	// give time for card profile to be set
-	waitForOpFinish(o);
+/* subscription */
+
+void PAManager::subscribeCallback(
+		pa_context* c, pa_subscription_event_type_t t, uint32_t idx, void* userdata) {
+	Trace::Span span("PAManager::subscribeCallback");
+	auto self = static_cast<PAManager*>(userdata);
+	auto facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+	bool removed = (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE;
+	// devices that just appeared are checked against the rules on the way
+	bool checkRules = (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW
+			&& !self->rules.empty();
+
+	// new and changed objects get introspected by index, removals only need the index
+	pa_operation* o = nullptr;
+	switch (facility) {
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		if (removed) {
+			QMetaObject::invokeMethod(
+					self, [self, idx] { self->removeSink(idx); }, Qt::QueuedConnection);
+		} else if (checkRules) {
+			auto device = new NewDevice{self, Stats::now()};
+			o = pa_context_get_sink_info_by_index(c, idx, &PAManager::newSinkInfoCallback, device);
+			if (!o)
+				delete device;
+		} else {
+			o = pa_context_get_sink_info_by_index(c, idx, &PAManager::sinkInfoCallback, self);
+		}
+		break;
+	case PA_SUBSCRIPTION_EVENT_CARD:
+		if (removed) {
+			QMetaObject::invokeMethod(
+					self, [self, idx] { self->removeCard(idx); }, Qt::QueuedConnection);
+		} else if (checkRules) {
+			auto device = new NewDevice{self, Stats::now()};
+			o = pa_context_get_card_info_by_index(c, idx, &PAManager::newCardInfoCallback, device);
+			if (!o)
+				delete device;
+		} else {
+			o = pa_context_get_card_info_by_index(c, idx, &PAManager::cardInfoCallback, self);
+		}
+		break;
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+		if (removed)
+			QMetaObject::invokeMethod(
+					self, [self, idx] { self->streams.remove(idx); }, Qt::QueuedConnection);
+		else
+			o = pa_context_get_sink_input_info_by_index(
+					c, idx, &PAManager::sinkInputInfoCallback, self);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+		o = pa_context_get_server_info(c, &PAManager::serverInfoCallback, self);
+		break;
+	default:
+		break;
+	}
 
-	// rebuild sink list
-	buildSinkList();
+	if (o)
+		pa_operation_unref(o);
+}
 
-	// PipeWire likes to change the sink after changing a card - switch back to
-	// the current default sink, if it's still available. Otherwise, just guess
-	// which sink the user wants
-	pa_threaded_mainloop_lock(mainloop);
+void PAManager::sinkInfoCallback(pa_context*, const pa_sink_info* info, int eol, void* userdata) {
+	Trace::Span span("PAManager::sinkInfoCallback");
+	if (eol || !info)
+		return;
 
-	bool oldSinkExists = true;
-	struct cbStruct {
-		bool& b;
-		pa_threaded_mainloop* mainloop;
-		std::string sink_name;
-	} s{oldSinkExists, mainloop, oldSinkName};
-
-	auto cbf = [](pa_context* c, int suc, void* data) {
-		auto items = static_cast<cbStruct*>(data);
-		if (!suc) {
-			items->b = false;
-			std::cout << "Failed to set sink to " << items->sink_name << std::endl;
-		} else
-			std::cout << "Successfully changed to sink " << items->sink_name << std::endl;
-
-		pa_threaded_mainloop_signal(items->mainloop, 0);
-	};
-	o = pa_context_set_default_sink(context, oldSinkName.c_str(), cbf, static_cast<void*>(&s));
-	pa_threaded_mainloop_unlock(mainloop);
-	waitForOpFinish(o);
+	auto self = static_cast<PAManager*>(userdata);
+	SinkInfo sink = sinkFromInfo(info);
+	QMetaObject::invokeMethod(self, [self, sink] { self->updateSink(sink); }, Qt::QueuedConnection);
+}
 
-	// guess the name of the newly created sink and try setting it
-	if (!oldSinkExists) {
-		pa_threaded_mainloop_lock(mainloop);
-		// replace alsa_card with alsa_output
-		std::string card_name = card->name; // alsa_card.XXX...
-		card_name.replace(5, 4, "output");  // alsa_output
+void PAManager::cardInfoCallback(pa_context*, const pa_card_info* info, int eol, void* userdata) {
+	Trace::Span span("PAManager::cardInfoCallback");
+	if (eol || !info)
+		return;
 
-		// remove "output:" from profile name
-		profile_name.replace(0, 7, "");
+	auto self = static_cast<PAManager*>(userdata);
+	CardInfo card = cardFromInfo(info);
+	QMetaObject::invokeMethod(self, [self, card] { self->updateCard(card); }, Qt::QueuedConnection);
+}
 
-		// some profile names seem to have two colons? the stuff after the last
-		// one seems to be the sink name
-		auto colonLoc = profile_name.find(':');
-		if (colonLoc != std::string::npos)
-			profile_name.replace(0, colonLoc + 1, "");
+void PAManager::newSinkInfoCallback(
+		pa_context*, const pa_sink_info* info, int eol, void* userdata) {
+	Trace::Span span("PAManager::newSinkInfoCallback");
+	auto device = static_cast<NewDevice*>(userdata);
+	if (eol) {
+		delete device;
+		return;
+	}
+	if (!info)
+		return;
 
-		std::string guessedSink = card_name + "." + profile_name;
+	PAManager* self = device->manager;
+	SinkInfo sink = sinkFromInfo(info);
+	int rule = self->rules.match(RulesEngine::Target::Sink, info->name, info->proplist);
+	qint64 eventNs = device->eventNs;
+	QMetaObject::invokeMethod(
+			self,
+			[self, sink, rule, eventNs] {
+				self->updateSink(sink);
+				if (rule != -1)
+					self->applySinkRule(rule, sink, eventNs);
+			},
+			Qt::QueuedConnection);
+}
 
-		s.sink_name = guessedSink;
-		o = pa_context_set_default_sink(context, guessedSink.c_str(), cbf, static_cast<void*>(&s));
-		pa_threaded_mainloop_unlock(mainloop);
-		waitForOpFinish(o);
+void PAManager::newCardInfoCallback(
+		pa_context*, const pa_card_info* info, int eol, void* userdata) {
+	Trace::Span span("PAManager::newCardInfoCallback");
+	auto device = static_cast<NewDevice*>(userdata);
+	if (eol) {
+		delete device;
+		return;
 	}
+	if (!info)
+		return;
 
-	// small sleep to give time for default sink to be updated
-	pa_msleep(100);
-	getDefaultSink();
+	PAManager* self = device->manager;
+	CardInfo card = cardFromInfo(info);
+	int rule = self->rules.match(RulesEngine::Target::Card, info->name, info->proplist);
+	qint64 eventNs = device->eventNs;
+	QMetaObject::invokeMethod(
+			self,
+			[self, card, rule, eventNs] {
+				self->updateCard(card);
+				if (rule != -1)
+					self->applyCardRule(rule, card, eventNs);
+			},
+			Qt::QueuedConnection);
 }
 
-// get card profiles into qml
-QStringList Card::getProfileList() const {
-	QStringList list;
-	for (const auto& profile : availableProfiles)
-		list << profile.description.c_str();
-	return list;
+void PAManager::serverInfoCallback(pa_context*, const pa_server_info* info, void* userdata) {
+	Trace::Span span("PAManager::serverInfoCallback");
+	if (!info)
+		return;
+
+	auto self = static_cast<PAManager*>(userdata);
+	std::string name = (info->default_sink_name) ? info->default_sink_name : "";
+	QMetaObject::invokeMethod(
+			self, [self, name] { self->updateDefaultSink(name); }, Qt::QueuedConnection);
 }
 
-Profile Card::getActiveProfile() {
-	emit profilesChanged();
-	return availableProfiles[activeProfileIndex];
+void PAManager::sinkInputInfoCallback(
+		pa_context*, const pa_sink_input_info* info, int eol, void* userdata) {
+	Trace::Span span("PAManager::sinkInputInfoCallback");
+	// vrdio's own mirror streams aren't applications
+	if (eol || !info || pa_proplist_gets(info->proplist, strings::mirror_prop))
+		return;
+
+	auto self = static_cast<PAManager*>(userdata);
+	StreamInfo stream = streamFromInfo(info);
+	QMetaObject::invokeMethod(
+			self, [self, stream] { self->streams.update(stream); }, Qt::QueuedConnection);
 }
 
-/* helper functions */
+SinkInfo PAManager::sinkFromInfo(const pa_sink_info* sink) {
+	const char* alsaCard = pa_proplist_gets(sink->proplist, "alsa.card");
+	const char* profile = pa_proplist_gets(sink->proplist, PA_PROP_DEVICE_PROFILE_NAME);
+	return {sink->name, sink->description, sink->index, sink->volume, sink->mute != 0,
+			(sink->monitor_source_name) ? sink->monitor_source_name : "", sink->card,
+			(alsaCard) ? alsaCard : "", (profile) ? profile : ""};
+}
 
-void PAManager::getDefaultSink() {
-	struct cbStruct {
-		std::vector<Sink>& sink_list;
-		int& def_index;
-		pa_threaded_mainloop* mainloop;
-	};
-	cbStruct s = {sinkList, defaultSinkIndex, mainloop};
-
-	auto callback = [](pa_context*, const pa_server_info* info, void* data) {
-		auto items = static_cast<cbStruct*>(data);
-		std::string defaultSinkName = info->default_sink_name;
-		for (int i = 0; i < items->sink_list.size(); i++) {
-			if (items->sink_list[i].name == defaultSinkName) {
-				items->def_index = i;
-				break;
-			}
+CardInfo PAManager::cardFromInfo(const pa_card_info* card) {
+	CardInfo c;
+	c.name = card->name;
+	c.index = card->index;
+	const char* alsaCard = pa_proplist_gets(card->proplist, "alsa.card");
+	c.alsaCard = (alsaCard) ? alsaCard : "";
+	const char* desc = pa_proplist_gets(card->proplist, "device.description");
+	c.description = (desc) ? desc : card->name;
+	c.activeProfileIndex = 0;
+
+	for (unsigned int i = 0; i < card->n_profiles; i++) {
+		if (card->profiles2[i]->available) {
+			Profile p;
+			p.name = card->profiles2[i]->name;
+			p.description = card->profiles2[i]->description;
+			p.active = (card->profiles2[i] == card->active_profile2);
+			p.sinks = card->profiles2[i]->n_sinks;
+			// index into the available profiles, not all of them
+			if (p.active)
+				c.activeProfileIndex = c.profiles.size();
+			c.profiles.push_back(p);
 		}
-		pa_threaded_mainloop_signal(items->mainloop, 0);
-	};
-	pa_operation* o = pa_context_get_server_info(context, callback, static_cast<void*>(&s));
-	waitForOpFinish(o);
+	}
+	return c;
+}
+
+StreamInfo PAManager::streamFromInfo(const pa_sink_input_info* info) {
+	StreamInfo s;
+	s.index = info->index;
+	s.sink = info->sink;
+	const char* app = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_NAME);
+	s.name = (app) ? app : info->name;
+	const char* media = pa_proplist_gets(info->proplist, PA_PROP_MEDIA_NAME);
+	s.title = (media && s.name != media) ? media : "";
+	const char* icon = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_ICON_NAME);
+	s.iconName = (icon) ? icon : "";
+	s.volume = info->volume;
+	s.mute = info->mute != 0;
+	return s;
+}
+
+void PAManager::updateSink(const SinkInfo& sink) {
+	int row = sinks.rowOf(sink.index);
+	if (row == -1) {
+		sinks.update(sink);
+		syncDefaultSinkIndex();
+		checkProfileSwitches();
+		return;
+	}
+
+	bool volChanged = !pa_cvolume_equal(&sinks.at(row).volume, &sink.volume);
+	bool muteFlipped = sinks.at(row).mute != sink.mute;
+	sinks.update(sink);
+
+	if (sink.name == defaultSinkName) {
+		updateMonitors();
+		if (volChanged)
+			emit volumeChanged();
+		if (muteFlipped)
+			emit muteChanged();
+	}
+}
+
+void PAManager::removeSink(uint32_t index) {
+	if (sinks.rowOf(index) == -1)
+		return;
+
+	sinks.remove(index);
+	syncDefaultSinkIndex();
+}
+
+void PAManager::updateCard(const CardInfo& info) { cards.update(info); }
+
+void PAManager::removeCard(uint32_t index) { cards.remove(index); }
+
+void PAManager::updateDefaultSink(const std::string& name) {
+	if (name == defaultSinkName)
+		return;
+
+	defaultSinkName = name;
+	defaultSinkIndex = sinks.rowOf(name);
+	updateMonitors();
 	emit newDefaultSink();
+	emit volumeChanged();
+	emit muteChanged();
+	checkProfileSwitches();
 }
 
-void PAManager::buildSinkList() {
-	pa_threaded_mainloop_lock(mainloop);
-	if (!sinkList.empty())
-		sinkList.clear();
+// the default sink's position in sinks can move when sinks come and go
+void PAManager::syncDefaultSinkIndex() {
+	int index = sinks.rowOf(defaultSinkName);
+	if (index == defaultSinkIndex)
+		return;
 
-	struct cbStruct {
-		std::vector<Sink>& sink_list;
-		pa_threaded_mainloop* mainloop;
-	};
-	cbStruct s = {sinkList, mainloop};
+	defaultSinkIndex = index;
+	updateMonitors();
+	emit newDefaultSink();
+	emit volumeChanged();
+	emit muteChanged();
+}
 
-	auto callback = [](pa_context*, const pa_sink_info* sink, int eol, void* data) {
-		auto items = static_cast<cbStruct*>(data);
-		if (eol) {
-			pa_threaded_mainloop_signal(items->mainloop, 0);
-			return;
-		}
-		Sink s = {sink->name, sink->description, sink->index, sink->volume};
-		items->sink_list.push_back(s);
-	};
+StreamModel* PAManager::getStreams() { return &streams; }
+
+LevelMeter* PAManager::getMeter() { return &meter; }
+
+AudioMirror* PAManager::getMirror() { return &mirror; }
+
+void PAManager::updateMonitors() {
+	if (defaultSinkIndex == -1) {
+		meter.setSource("", 0);
+		mirror.setSource("", "");
+		return;
+	}
+
+	const SinkInfo& sink = sinks.at(defaultSinkIndex);
+	meter.setSource(sink.monitor, sink.volume.channels);
+	mirror.setSource(sink.monitor, sink.name);
+}
 
-	pa_operation* o = pa_context_get_sink_info_list(context, callback, static_cast<void*>(&s));
+int PAManager::sinkPosition(uint sinkIndex) const {
+	Trace::Span span("PAManager::sinkPosition");
+	return sinks.rowOf(sinkIndex);
+}
+
+// the model is patched right away so sliders don't jump back while the server catches up. the
+// subscription corrects it if the change doesn't go through
+QFuture<bool> PAManager::setStreamVolume(uint streamIndex, int newPct) {
+	Trace::Span span("PAManager::setStreamVolume");
+	PendingOp* op = beginOp("stream volume");
+	const StreamInfo* stream = streams.find(streamIndex);
+	if (!stream)
+		return trackOp(op, nullptr);
+
+	StreamInfo patched = *stream;
+	int newVol = PA_VOLUME_NORM * ((double)newPct / 100);
+	pa_cvolume_set(&patched.volume, patched.volume.channels, newVol);
+	streams.update(patched);
+	return queueVolume(VolumeTarget::Stream, streamIndex, patched.volume, op);
+}
+
+QFuture<bool> PAManager::setStreamMute(uint streamIndex, bool mute) {
+	Trace::Span span("PAManager::setStreamMute");
+	PendingOp* op = beginOp("stream mute");
+	const StreamInfo* stream = streams.find(streamIndex);
+	if (!stream)
+		return trackOp(op, nullptr);
+
+	StreamInfo patched = *stream;
+	patched.mute = mute;
+	streams.update(patched);
+
+	pa_threaded_mainloop_lock(mainloop);
+	pa_operation* o = pa_context_set_sink_input_mute(
+			context, streamIndex, mute, &PAManager::opCallback, op);
 	pa_threaded_mainloop_unlock(mainloop);
-	waitForOpFinish(o);
-	emit sinksChanged();
+	return trackOp(op, o);
 }
 
-void PAManager::buildCardList() {
-	struct cbStruct {
-		std::vector<std::unique_ptr<Card>>& card_list;
-		pa_threaded_mainloop* mainloop;
-	};
-	cbStruct s = {cardList, mainloop};
+QFuture<bool> PAManager::moveStream(uint streamIndex, int sinkIndex) {
+	Trace::Span span("PAManager::moveStream");
+	PendingOp* op = beginOp("stream move");
+	if (sinkIndex < 0 || sinkIndex >= sinks.rowCount() || !streams.find(streamIndex))
+		return trackOp(op, nullptr);
 
-	auto callback = [](pa_context*, const pa_card_info* card, int eol, void* data) {
-		auto items = static_cast<cbStruct*>(data);
-		if (eol) {
-			if (pa_threaded_mainloop_in_thread(items->mainloop))
-				pa_threaded_mainloop_signal(items->mainloop, 0);
-			return;
-		}
+	pa_threaded_mainloop_lock(mainloop);
+	pa_operation* o = pa_context_move_sink_input_by_index(
+			context, streamIndex, sinks.at(sinkIndex).index, &PAManager::opCallback, op);
+	pa_threaded_mainloop_unlock(mainloop);
+	return trackOp(op, o);
+}
 
-		auto c = std::make_unique<Card>();
-		c->name = card->name;
-		c->index = card->index;
-		const char* desc = pa_proplist_gets(card->proplist, "device.description");
-		c->description = (desc) ? desc : card->name;
-
-		for (unsigned int i = 0; i < card->n_profiles; i++) {
-			if (card->profiles2[i]->available) {
-				Profile p;
-				p.name = card->profiles2[i]->name;
-				p.description = card->profiles2[i]->description;
-				p.active = (card->profiles2[i] == card->active_profile2);
-				c->availableProfiles.push_back(p);
-				if (p.active)
-					c->activeProfileIndex = i;
-			}
+QFuture<bool> PAManager::loadCards() {
+	Trace::Span span("PAManager::loadCards");
+	PendingOp* op = beginOp("cards");
+	QFuture<bool> future = op->promise.future();
+	whenConnected([this, op](bool connected) {
+		if (!connected) {
+			finishOp(op, false);
+			return;
 		}
-		items->card_list.push_back(std::move(c));
-	};
+		trackOp(op, pa_context_get_card_info_list(context, &PAManager::cardListCallback, op));
+	});
+	return future;
+}
 
-	pa_operation* o = pa_context_get_card_info_list(context, callback, static_cast<void*>(&s));
-	waitForOpFinish(o);
+void PAManager::cardListCallback(pa_context* c, const pa_card_info* info, int eol, void* userdata) {
+	Trace::Span span("PAManager::cardListCallback");
+	auto op = static_cast<PendingOp*>(userdata);
+	// queued behind the cards themselves, so the model is complete when the future resolves
+	if (eol)
+		op->manager->finishOp(op, eol > 0);
+	else
+		cardInfoCallback(c, info, eol, op->manager);
 }
 
-bool PAManager::saveConfig() {
-	// class to make sure mainloop is always unlocked at the end
-	class threadChk {
-	  private:
-		pa_threaded_mainloop* ml;
+/* rules */
 
-	  public:
-		explicit threadChk(pa_threaded_mainloop* ml_) : ml(ml_) { pa_threaded_mainloop_lock(ml); }
-		~threadChk() { pa_threaded_mainloop_unlock(ml); }
+void PAManager::applySinkRule(int ruleIndex, const SinkInfo& sink, qint64 eventNs) {
+	Trace::Span span("PAManager::applySinkRule");
+	const RulesEngine::Rule& rule = rules.rule(ruleIndex);
+	std::cout << "Rule " << rule.name.toStdString() << " matched sink " << sink.name << std::endl;
+
+	// timed from the plug event, so the stats show how long until audio was routed
+	PendingOp* op = beginOp("rule");
+	if (op->startNs)
+		op->startNs = eventNs;
+	if (rule.volume >= 0)
+		changeSinkVolume(sinks.rowOf(sink.index), rule.volume);
+
+	pa_threaded_mainloop_lock(mainloop);
+	pa_operation* o = pa_context_set_default_sink(
+			context, sink.name.c_str(), &PAManager::opCallback, op);
+	pa_threaded_mainloop_unlock(mainloop);
+	trackOp(op, o);
+}
+
+// the card's sinks may not be there yet, so the rest happens like a profile switch from the
+// overlay: once the sink shows up it gets the volume and becomes the default
+void PAManager::applyCardRule(int ruleIndex, const CardInfo& card, qint64 eventNs) {
+	Trace::Span span("PAManager::applyCardRule");
+	const RulesEngine::Rule& rule = rules.rule(ruleIndex);
+	std::cout << "Rule " << rule.name.toStdString() << " matched card " << card.name << std::endl;
+
+	PendingOp* op = beginOp("rule");
+	if (op->startNs)
+		op->startNs = eventNs;
+	auto sw = new ProfileSwitch{this, op, card.index, card.alsaCard, card.name};
+	sw->sinkName = rule.sink;
+	sw->volume = rule.volume;
+	profileSwitches.push_back(sw);
+
+	// without a profile in the rule, the card keeps the one it came up with
+	auto wanted = [&rule](const Profile& p) {
+		return rule.profile.empty() ? p.active : p.name == rule.profile;
 	};
-	threadChk T(mainloop);
+	auto profile = std::find_if(card.profiles.begin(), card.profiles.end(), wanted);
+	if (profile == card.profiles.end()) {
+		std::cout << "Card " << card.name << " has no profile " << rule.profile << std::endl;
+		finishProfileSwitch(sw, false);
+		return;
+	}
+	sw->profileName = profile->name;
+	sw->profileSinks = profile->sinks;
 
-	std::string sink_name = sinkList[defaultSinkIndex].name;
+	if (profile->active)
+		profileApplied(sw, true);
+	else
+		sendProfileSwitch(sw);
+}
+
+/* config */
+
+QFuture<bool> PAManager::saveConfig() {
+	Trace::Span span("PAManager::saveConfig");
+	PendingOp* op = beginOp("save-config");
+	QFuture<bool> future = op->promise.future();
+
+	// cards are only fetched on demand. saving without them would write an empty card and
+	// profile, and the profile would be lost on the next loadConfig
+	if (defaultSinkIndex != -1 && sinks.at(defaultSinkIndex).card != PA_INVALID_INDEX
+			&& !cards.find(sinks.at(defaultSinkIndex).card))
+		loadCards().then(this, [this, op](bool loaded) { finishOp(op, loaded && writeConfig()); });
+	else
+		finishOp(op, writeConfig());
+	return future;
+}
 
-	// card name should be first part of sink name (alsa_card.pci_XXXX)
-	std::string card_name = sink_name;
+bool PAManager::writeConfig() {
+	if (defaultSinkIndex == -1)
+		return false;
 
-	// change "output" to "card"
-	card_name.replace(5, 6, "card");
-	auto profile_name_loc = card_name.rfind('.');
+	const SinkInfo& sink = sinks.at(defaultSinkIndex);
+	std::string sink_name = sink.name;
 
-	// save profile name from end of sink name
-	std::string profile_name = card_name.substr(profile_name_loc + 1);
-	profile_name = "output:" + profile_name;
-	card_name.replace(card_name.begin() + profile_name_loc, card_name.end(), "");
+	// the sink's card and its current profile, if the cards are known. sinks without a card
+	// only save themselves
+	std::string card_name, profile_name;
+	if (const Card* card = cards.find(sink.card)) {
+		card_name = card->name;
+		if (!card->availableProfiles().empty())
+			profile_name = card->getActiveProfile().name;
+	}
 
 	QDir config_dir(strings::config_dir_loc);
 	if (!config_dir.exists()) {
@@ -369,13 +974,13 @@ bool PAManager::saveConfig() {
 	return true;
 }
 
-void PAManager::loadConfig() {
-	pa_threaded_mainloop_lock(mainloop);
+QFuture<bool> PAManager::loadConfig() {
+	Trace::Span span("PAManager::loadConfig");
+	PendingOp* op = beginOp("config");
 	QFile config(strings::audioconfig_loc);
 	if (!config.open(QFile::ReadOnly)) {
 		std::cout << "No configuration file found." << std::endl;
-		pa_threaded_mainloop_unlock(mainloop);
-		return;
+		return trackOp(op, nullptr);
 	}
 
 	QTextStream in(&config);
@@ -394,47 +999,206 @@ void PAManager::loadConfig() {
 
 	config.close();
 
-	// attempt to set profile
-	struct cbStruct {
-		QString& cardStr;
-		QString& profileStr;
-		pa_threaded_mainloop* mainloop;
-	} s{card, profile, mainloop};
-
-	auto callback = [](pa_context* c, int success, void* data) {
-		auto items = static_cast<cbStruct*>(data);
-		if (!success)
-			std::clog << "Could not set profile " << items->profileStr.toStdString() << " on card "
-					  << items->cardStr.toStdString() << std::endl;
-		pa_threaded_mainloop_signal(items->mainloop, 0);
-	};
+	QFuture<bool> future = op->promise.future();
+	std::string sinkName = sink.toStdString();
+	// sinks without a card were saved on their own
+	if (card.isEmpty() || profile.isEmpty()) {
+		whenConnected([this, op, sinkName](bool connected) {
+			pa_operation* o = nullptr;
+			if (connected)
+				o = pa_context_set_default_sink(
+						context, sinkName.c_str(), &PAManager::opCallback, op);
+			trackOp(op, o);
+		});
+		return future;
+	}
 
-	pa_operation* o = pa_context_set_card_profile_by_name(
-			context, card.toUtf8(), profile.toUtf8(), callback, &s);
-	pa_threaded_mainloop_unlock(mainloop);
-	waitForOpFinish(o);
+	// set the profile, then the sink once it exists. the config has the sink's name
+	auto sw = new ProfileSwitch{this, op};
+	sw->cardName = card.toStdString();
+	sw->profileName = profile.toStdString();
+	sw->sinkName = sinkName;
+	profileSwitches.push_back(sw);
 
-	pa_threaded_mainloop_lock(mainloop);
-	struct cbStruct2 {
-		QString& sinkStr;
-		pa_threaded_mainloop* mainloop;
-	} s2{sink, mainloop};
-
-	auto callback2 = [](pa_context* c, int success, void* data) {
-		auto items = static_cast<cbStruct2*>(data);
-		if (!success)
-			std::clog << "Could not set sink to " << items->sinkStr.toStdString() << std::endl;
-		else
-			std::clog << "Set sink to " << items->sinkStr.toStdString() << std::endl;
-		pa_threaded_mainloop_signal(items->mainloop, 0);
-	};
-	o = pa_context_set_default_sink(context, sink.toUtf8(), callback2, &s2);
-	pa_threaded_mainloop_unlock(mainloop);
-	waitForOpFinish(o);
-	// small sleep to give time for sink to be updated (seems to be a PipeWire issue?)
-	pa_msleep(20);
+	// at startup this goes out together with the initial requests
+	sendProfileSwitch(sw);
+	return future;
 }
 
-bool PAManager::Sink::operator==(const Sink& other) const {
-	return (name == other.name && description == other.description && index == other.index);
+QJsonObject PAManager::toJson() const {
+	QJsonArray sinkList;
+	for (int row = 0; row < sinks.rowCount(); row++) {
+		const SinkInfo& sink = sinks.at(row);
+		sinkList.append(QJsonObject{
+				{"name", QString::fromStdString(sink.name)},
+				{"description", QString::fromStdString(sink.description)},
+				{"volume", volumePct(sink.volume)},
+				{"muted", sink.mute},
+				{"default", row == defaultSinkIndex},
+		});
+	}
+
+	QJsonArray cardList;
+	for (int row = 0; row < cards.rowCount(); row++) {
+		Card* card = cards.get(row);
+		QJsonArray profiles;
+		QString active;
+		if (!card->availableProfiles().empty())
+			active = QString::fromStdString(card->getActiveProfile().name);
+		for (const Profile& profile : card->availableProfiles())
+			profiles.append(QJsonObject{
+					{"name", QString::fromStdString(profile.name)},
+					{"description", QString::fromStdString(profile.description)},
+			});
+		cardList.append(QJsonObject{
+				{"name", QString::fromStdString(card->name)},
+				{"description", card->description},
+				{"profile", active},
+				{"profiles", profiles},
+		});
+	}
+	return QJsonObject{{"sinks", sinkList}, {"cards", cardList}};
+}
+
+/* presets */
+
+QStringList PAManager::getPresets() const {
+	QStringList names;
+	for (const Preset& preset : presets)
+		names << preset.name;
+	return names;
+}
+
+bool PAManager::savePreset(const QString& name) {
+	Trace::Span span("PAManager::savePreset");
+	if (name.isEmpty())
+		return false;
+
+	Preset preset;
+	preset.name = name;
+	if (defaultSinkIndex != -1) {
+		const SinkInfo& sink = sinks.at(defaultSinkIndex);
+		preset.defaultSink = sink.name;
+		if (const Card* card = cards.find(sink.card))
+			preset.defaultSinkCard = card->name;
+	}
+	for (int i = 0; i < sinks.rowCount(); i++) {
+		const SinkInfo& sink = sinks.at(i);
+		preset.sinks.push_back({sink.name, sink.volume, sink.mute});
+	}
+	// cards are only known once they were loaded, which opening the overlay does
+	for (int i = 0; i < cards.rowCount(); i++) {
+		const Card* card = cards.get(i);
+		if (!card->availableProfiles().empty())
+			preset.cards.push_back({card->name, card->getActiveProfile().name});
+	}
+
+	std::vector<Preset> updated = presets;
+	auto it = std::find_if(updated.begin(), updated.end(),
+			[&name](const Preset& p) { return p.name == name; });
+	if (it != updated.end())
+		*it = preset;
+	else
+		updated.push_back(preset);
+
+	if (!Preset::save(strings::presets_loc, updated))
+		return false;
+	presets = std::move(updated);
+	emit presetsChanged();
+	return true;
+}
+
+bool PAManager::removePreset(const QString& name) {
+	Trace::Span span("PAManager::removePreset");
+	std::vector<Preset> updated = presets;
+	auto it = std::find_if(updated.begin(), updated.end(),
+			[&name](const Preset& p) { return p.name == name; });
+	if (it == updated.end())
+		return false;
+	updated.erase(it);
+
+	if (!Preset::save(strings::presets_loc, updated))
+		return false;
+	presets = std::move(updated);
+	emit presetsChanged();
+	return true;
+}
+
+QFuture<bool> PAManager::applyPreset(const QString& name) {
+	Trace::Span span("PAManager::applyPreset");
+	PendingOp* op = beginOp("preset");
+	auto preset = std::find_if(presets.begin(), presets.end(),
+			[&name](const Preset& p) { return p.name == name; });
+	if (preset == presets.end())
+		return trackOp(op, nullptr);
+
+	// every change goes out right away, none of them waits for the one before
+	std::vector<QFuture<bool>> steps;
+	bool defaultDone = preset->defaultSink.empty() || preset->defaultSink == defaultSinkName;
+
+	for (const Preset::CardSetting& setting : preset->cards) {
+		// unplugged, or the cards weren't loaded yet
+		Card* card = cards.find(setting.name);
+		if (!card || card->availableProfiles().empty()
+				|| card->getActiveProfile().name == setting.profile)
+			continue;
+		const std::vector<Profile>& profiles = card->availableProfiles();
+		auto profile = std::find_if(profiles.begin(), profiles.end(),
+				[&setting](const Profile& p) { return p.name == setting.profile; });
+		if (profile == profiles.end())
+			continue;
+
+		PendingOp* step = beginOp("profile");
+		steps.push_back(step->promise.future());
+		auto sw = new ProfileSwitch{this, step, card->index, card->alsaCard, card->name,
+				profile->name, profile->sinks};
+		card->activeProfileIndex = profile - profiles.begin();
+		// the preset's default sink may only exist once its card has the right profile
+		if (!defaultDone && setting.name == preset->defaultSinkCard) {
+			sw->sinkName = preset->defaultSink;
+			defaultDone = true;
+		} else {
+			sw->keepDefault = true;
+		}
+		profileSwitches.push_back(sw);
+		sendProfileSwitch(sw);
+	}
+
+	if (!defaultDone)
+		steps.push_back(changeSink(sinks.rowOf(preset->defaultSink)));
+
+	for (const Preset::SinkSetting& setting : preset->sinks) {
+		// sinks a profile switch replaces get their volume back from the server
+		int row = sinks.rowOf(setting.name);
+		if (row == -1)
+			continue;
+
+		SinkInfo sink = sinks.at(row);
+		// the channel map can differ with another profile, then only the level is kept
+		pa_cvolume volume = setting.volume;
+		if (volume.channels != sink.volume.channels)
+			pa_cvolume_set(&volume, sink.volume.channels, pa_cvolume_max(&setting.volume));
+		if (!pa_cvolume_equal(&volume, &sink.volume)) {
+			sink.volume = volume;
+			updateSink(sink);
+			steps.push_back(queueVolume(VolumeTarget::Sink, sink.index, volume, beginOp("volume")));
+		}
+		if (sink.mute != setting.mute)
+			steps.push_back(muteSink(row, setting.mute));
+	}
+
+	// resolves once every step has, successful only if all of them were
+	QFuture<bool> future = op->promise.future();
+	if (steps.empty())
+		finishOp(op, true);
+	auto remaining = std::make_shared<std::size_t>(steps.size());
+	auto success = std::make_shared<bool>(true);
+	for (QFuture<bool>& step : steps) {
+		step.then(this, [this, op, remaining, success](bool ok) {
+			*success = *success && ok;
+			if (--*remaining == 0)
+				finishOp(op, *success);
+		});
+	}
+	return future;
 }
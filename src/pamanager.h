@@ -1,91 +1,265 @@
 #ifndef PAMANAGER_H
 #define PAMANAGER_H
 
+#include "audiomirror.h"
+#include "devicemodels.h"
+#include "levelmeter.h"
+#include "preset.h"
+#include "rulesengine.h"
+#include "streammodel.h"
+
+#include <QDeadlineTimer>
+#include <QFuture>
+#include <QJsonObject>
 #include <QMetaType>
 #include <QObject>
-#include <QQmlListProperty>
-#include <memory>
+#include <QPromise>
+#include <QStringList>
+#include <QTimer>
+#include <functional>
+#include <map>
 #include <pulse/pulseaudio.h>
 #include <string>
+#include <vector>
 // pamanager.h: holds all pulseaudio related actions
 
-struct Profile {
-	std::string name;
-	std::string description;
-	bool active;
-};
-class Card : public QObject {
-	Q_OBJECT
-	Q_PROPERTY(QString description MEMBER description CONSTANT)
-	Q_PROPERTY(QStringList profiles READ getProfileList CONSTANT)
-	Q_PROPERTY(Profile activeProfile READ getActiveProfile)
-	Q_PROPERTY(int activeProfileIndex MEMBER activeProfileIndex)
-  public:
-	std::string name; // alsa_card_XXXXX...
-	uint32_t index;
-	QString description;
-	std::vector<Profile> availableProfiles;
-
-	unsigned int activeProfileIndex;
-	Profile getActiveProfile();
-	QStringList getProfileList() const;
-  signals:
-	void profilesChanged();
-};
-
 class PAManager : public QObject {
 	Q_OBJECT
-	Q_PROPERTY(QStringList sinks READ getSinkList NOTIFY sinksChanged)
-	Q_PROPERTY(QVariantList cards READ getCardList NOTIFY cardsChanged)
+	Q_PROPERTY(SinkModel* sinks READ getSinks CONSTANT)
+	Q_PROPERTY(CardModel* cards READ getCards CONSTANT)
 	Q_PROPERTY(int sinkIndex READ getDefaultSinkIndex NOTIFY newDefaultSink)
+	Q_PROPERTY(int volume READ getVolPct NOTIFY volumeChanged)
+	Q_PROPERTY(bool muted READ isMuted NOTIFY muteChanged)
+	Q_PROPERTY(int pendingOperations READ getPendingOperations NOTIFY pendingOperationsChanged)
+	Q_PROPERTY(StreamModel* streams READ getStreams CONSTANT)
+	Q_PROPERTY(LevelMeter* meter READ getMeter CONSTANT)
+	Q_PROPERTY(AudioMirror* mirror READ getMirror CONSTANT)
+	Q_PROPERTY(qint64 droppedVolumeOps READ getDroppedVolumeOps NOTIFY droppedVolumeOpsChanged)
+	Q_PROPERTY(bool ready READ isReady NOTIFY readyChanged)
+	Q_PROPERTY(QStringList presets READ getPresets NOTIFY presetsChanged)
   public:
-	explicit PAManager(const char* appName);
+	// connects in the background, the lists fill in once the server answers. see ready.
+	// restore: apply the saved audio and mirror configuration and follow the device rules,
+	// which one-shot command line use doesn't want
+	explicit PAManager(const char* appName, bool restore = true);
 	~PAManager();
 
   public slots:
-	int getVolPct();
-	QStringList getSinkList();
-	QVariantList getCardList();
-	void changeVol(int newPct);
-	void changeSink(int sinkIndex);
-	void changeCardProfile(Card* card, const QString& profileName);
+	int getVolPct() const;
+	bool isMuted() const;
+	SinkModel* getSinks();
+	CardModel* getCards();
 	int getDefaultSinkIndex() const;
-	bool saveConfig();
-	void loadConfig();
+	int getPendingOperations() const;
+	// true once the sinks and the default sink are known
+	bool isReady() const;
+	// volume changes that were replaced by a newer one before they were sent
+	qint64 getDroppedVolumeOps() const;
+	StreamModel* getStreams();
+	LevelMeter* getMeter();
+	AudioMirror* getMirror();
+	// position of the sink with pulseaudio index sinkIndex in the sinks list, or -1
+	int sinkPosition(uint sinkIndex) const;
+
+	// these return right away. the future resolves (and operationFinished is emitted) once the
+	// server has answered, with whether the change was applied
+	QFuture<bool> changeVol(int newPct);
+	// mutes or unmutes the default sink
+	QFuture<bool> setMute(bool mute);
+	QFuture<bool> changeSink(int sinkIndex);
+	// by the description the overlay shows. the first profile with it wins
+	QFuture<bool> changeCardProfile(Card* card, const QString& profileName);
+	// by the profile's name, which unlike its description is unique on the card
+	QFuture<bool> changeCardProfileByName(Card* card, const std::string& name);
+	// the sinks and cards as they are known right now, for scripts. cards are only there once
+	// loaded
+	QJsonObject toJson() const;
+	// saves the default sink with its card and profile, fetching the cards first if needed
+	QFuture<bool> saveConfig();
+	QFuture<bool> loadConfig();
+	// cards are only fetched when they're first needed, after that the subscription keeps
+	// them up to date
+	QFuture<bool> loadCards();
+
+	// named snapshots of the default sink, sink volumes and mutes and card profiles, kept in
+	// presets.json. saving under an existing name replaces that preset
+	QStringList getPresets() const;
+	bool savePreset(const QString& name);
+	bool removePreset(const QString& name);
+	// only what differs from the current state is changed, all at once. resolves when every
+	// change has, successful only if all of them were
+	QFuture<bool> applyPreset(const QString& name);
+
+	// per stream controls, streamIndex is the stream's pulseaudio index
+	QFuture<bool> setStreamVolume(uint streamIndex, int newPct);
+	QFuture<bool> setStreamMute(uint streamIndex, bool mute);
+	QFuture<bool> moveStream(uint streamIndex, int sinkIndex);
 
   signals:
-	void sinksChanged();
-	void cardsChanged();
 	void newDefaultSink();
+	void volumeChanged();
+	void muteChanged();
+	void pendingOperationsChanged();
+	void droppedVolumeOpsChanged();
+	void operationFinished(const QString& kind, bool success);
+	void readyChanged();
+	void presetsChanged();
+
+  private slots:
+	// completes the profile switches whose sink showed up and fails the ones that waited too
+	// long for it
+	void checkProfileSwitches();
 
   private:
-	struct Sink {
-		std::string name;
-		std::string description; // user friendly name
+	// device lists. only ever modified on the GUI thread, from subscription events
+	SinkModel sinks;
+	CardModel cards;
+	// every playback stream, patched like the lists above
+	StreamModel streams;
+	// levels of the default sink and its mirror to other sinks. both follow it around
+	LevelMeter meter;
+	AudioMirror mirror;
+
+	pa_threaded_mainloop* mainloop;
+	pa_context* context;
+	int defaultSinkIndex;
+	std::string defaultSinkName;
+
+	// startup is pipelined: once the context is ready every initial request goes out at once,
+	// without waiting for the answers in between
+	qint64 createdNs;
+	bool ready;
+	// requests made while still connecting, run with whether that worked. mainloop lock
+	std::vector<std::function<void(bool)>> deferred;
+
+	std::vector<Preset> presets;
+	// loaded before connecting, read from the mainloop thread after that
+	RulesEngine rules;
+
+	// a mutation waiting on the server. created and destroyed on the GUI thread, but completed
+	// from whatever thread the server's answer arrives on
+	struct PendingOp {
+		PAManager* manager;
+		QString kind;
+		QPromise<bool> promise;
+		qint64 startNs; // only set while collecting stats
+	};
+	std::vector<PendingOp*> pendingOps;
+
+	PendingOp* beginOp(const QString& kind);
+	// hands the op's future back, failing the op right away if o couldn't be created
+	QFuture<bool> trackOp(PendingOp* op, pa_operation* o);
+	void finishOp(PendingOp* op, bool success);
+	// pa_context_success_cb_t for single step operations, userdata is the PendingOp
+	static void opCallback(pa_context* c, int success, void* userdata);
+
+	// volume changes are coalesced: at most one is in flight per sink or stream, and while it
+	// is, newer values replace each other. ops that got replaced resolve with the one that
+	// replaced them
+	enum class VolumeTarget { Sink, Stream };
+	struct VolumeSlot {
+		bool inFlight = false;
+		bool queued = false;
+		pa_cvolume volume;               // newest value that hasn't been sent yet
+		std::vector<PendingOp*> waiting; // answered by the next send
+	};
+	struct VolumeSend {
+		PAManager* manager;
+		VolumeTarget target;
 		uint32_t index;
-		pa_cvolume volume;
-		bool operator==(const Sink& other) const;
+		std::vector<PendingOp*> ops;
 	};
+	std::map<std::pair<VolumeTarget, uint32_t>, VolumeSlot> volumeSlots;
+	quint64 droppedVolumeOps;
 
-	std::vector<Sink> sinkList;
+	QFuture<bool> queueVolume(
+			VolumeTarget target, uint32_t index, const pa_cvolume& volume, PendingOp* op);
+	void sendVolume(VolumeTarget target, uint32_t index, const pa_cvolume& volume,
+			std::vector<PendingOp*> ops);
+	void volumeSent(VolumeSend* send, bool success);
+	static void volumeCallback(pa_context* c, int success, void* userdata);
+	// row in sinks, shown as (un)muted right away
+	QFuture<bool> muteSink(int row, bool mute);
+	QFuture<bool> changeSinkVolume(int row, int newPct);
 
-	// cardList is a vector of pointers because QObjects have no copy constructors.
-	std::vector<std::unique_ptr<Card>> cardList;
+	// a card profile change. the card's sinks get replaced, so it's only done once the sink it
+	// waits for exists and was made the default. GUI thread only
+	struct ProfileSwitch {
+		PAManager* manager;
+		PendingOp* op;
+		uint32_t card = PA_INVALID_INDEX;
+		std::string alsaCard;
+		std::string cardName; // when it's switched by name, from the config
+		std::string profileName;
+		unsigned int profileSinks = 0;
+		// made the default once it exists. if empty, whichever sink the profile gives the card
+		std::string sinkName;
+		int volume = -1;          // percent, set on the sink once it's found
+		bool keepDefault = false; // only switch the profile, leave the default sink alone
+		bool applied = false;     // the server has switched the profile
+		QDeadlineTimer deadline;
+	};
+	static constexpr int profileSwitchTimeoutMs = 3000;
+	std::vector<ProfileSwitch*> profileSwitches;
+	QTimer profileSwitchTimer; // fires at the earliest deadline
 
-	pa_threaded_mainloop* mainloop;
-	pa_context* context;
-	int defaultSinkIndex;
+	// sends the profile change by card name, as soon as the context is ready
+	void sendProfileSwitch(ProfileSwitch* sw);
+	static void profileSetCallback(pa_context* c, int success, void* userdata);
+	void profileApplied(ProfileSwitch* sw, bool success);
+	static bool switchWants(const ProfileSwitch& sw, const SinkInfo& sink);
+	void finishProfileSwitch(ProfileSwitch* sw, bool success);
+	// switches card to its profile at index, -1 fails the switch
+	QFuture<bool> switchCardProfile(Card* card, int profile);
+
+	// the part of saveConfig() that writes the file, with whatever cards are known
+	bool writeConfig();
 
-	static void waitForContext(pa_context* c, void* userdata);
+	// runs f with the mainloop locked once the context is ready, right away if it already is
+	void whenConnected(std::function<void(bool)> f);
+	static void contextStateCallback(pa_context* c, void* userdata);
+	// GUI thread, after the initial sinks and server info were patched in
+	void finishStartup();
+	static void startupServerInfoCallback(
+			pa_context* c, const pa_server_info* info, void* userdata);
+	// userdata is the PendingOp of loadCards
+	static void cardListCallback(pa_context* c, const pa_card_info* info, int eol, void* userdata);
 
-	// (Re)builds sink list
-	void buildSinkList();
+	// subscription callbacks - these run on the mainloop thread and only copy data over to the
+	// GUI thread, where the lists are patched
+	static void subscribeCallback(
+			pa_context* c, pa_subscription_event_type_t t, uint32_t idx, void* userdata);
+	static void sinkInfoCallback(pa_context* c, const pa_sink_info* info, int eol, void* userdata);
+	static void cardInfoCallback(pa_context* c, const pa_card_info* info, int eol, void* userdata);
+	static void serverInfoCallback(pa_context* c, const pa_server_info* info, void* userdata);
+	static void sinkInputInfoCallback(
+			pa_context* c, const pa_sink_input_info* info, int eol, void* userdata);
 
-	void getDefaultSink();
+	// devices that were just plugged in are checked against the rules on the way, userdata is
+	// a NewDevice
+	struct NewDevice {
+		PAManager* manager;
+		qint64 eventNs; // when the subscription event arrived, rules are timed from there
+	};
+	static void newSinkInfoCallback(
+			pa_context* c, const pa_sink_info* info, int eol, void* userdata);
+	static void newCardInfoCallback(
+			pa_context* c, const pa_card_info* info, int eol, void* userdata);
+	void applySinkRule(int rule, const SinkInfo& sink, qint64 eventNs);
+	void applyCardRule(int rule, const CardInfo& card, qint64 eventNs);
 
-	void buildCardList();
+	static SinkInfo sinkFromInfo(const pa_sink_info* info);
+	static CardInfo cardFromInfo(const pa_card_info* info);
+	static StreamInfo streamFromInfo(const pa_sink_input_info* info);
 
-	void waitForOpFinish(pa_operation*);
+	// in place updates, GUI thread only
+	void updateSink(const SinkInfo& sink);
+	void removeSink(uint32_t index);
+	void updateCard(const CardInfo& info);
+	void removeCard(uint32_t index);
+	void updateDefaultSink(const std::string& name);
+	void syncDefaultSinkIndex();
+	void updateMonitors();
 };
 
 #endif // PAMANAGER_H
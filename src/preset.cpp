@@ -0,0 +1,115 @@
+#include "preset.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <iostream>
+
+QJsonObject Preset::toJson() const {
+	QJsonArray sinkList;
+	for (const SinkSetting& s : sinks) {
+		// raw channel volumes, so applying the preset restores the balance too
+		QJsonArray volume;
+		for (int i = 0; i < s.volume.channels; i++)
+			volume.append(qint64(s.volume.values[i]));
+		sinkList.append(QJsonObject{
+				{"name", QString::fromStdString(s.name)},
+				{"volume", volume},
+				{"mute", s.mute},
+		});
+	}
+
+	QJsonArray cardList;
+	for (const CardSetting& c : cards) {
+		cardList.append(QJsonObject{
+				{"name", QString::fromStdString(c.name)},
+				{"profile", QString::fromStdString(c.profile)},
+		});
+	}
+
+	return QJsonObject{
+			{"name", name},
+			{"defaultSink", QString::fromStdString(defaultSink)},
+			{"defaultSinkCard", QString::fromStdString(defaultSinkCard)},
+			{"sinks", sinkList},
+			{"cards", cardList},
+	};
+}
+
+bool Preset::fromJson(const QJsonObject& obj, Preset& preset) {
+	preset = Preset{};
+	preset.name = obj["name"].toString();
+	if (preset.name.isEmpty())
+		return false;
+	preset.defaultSink = obj["defaultSink"].toString().toStdString();
+	preset.defaultSinkCard = obj["defaultSinkCard"].toString().toStdString();
+
+	for (const QJsonValue& value : obj["sinks"].toArray()) {
+		QJsonObject s = value.toObject();
+		QJsonArray volume = s["volume"].toArray();
+		if (volume.isEmpty() || volume.size() > PA_CHANNELS_MAX)
+			continue;
+
+		SinkSetting setting;
+		setting.name = s["name"].toString().toStdString();
+		setting.mute = s["mute"].toBool();
+		pa_cvolume_init(&setting.volume);
+		setting.volume.channels = volume.size();
+		for (int i = 0; i < volume.size(); i++)
+			setting.volume.values[i] = PA_CLAMP_VOLUME(pa_volume_t(volume[i].toInteger()));
+		preset.sinks.push_back(setting);
+	}
+
+	for (const QJsonValue& value : obj["cards"].toArray()) {
+		QJsonObject c = value.toObject();
+		CardSetting setting{c["name"].toString().toStdString(),
+				c["profile"].toString().toStdString()};
+		if (!setting.name.empty() && !setting.profile.empty())
+			preset.cards.push_back(setting);
+	}
+	return true;
+}
+
+std::vector<Preset> Preset::load(const QString& path) {
+	std::vector<Preset> presets;
+	QFile file(path);
+	if (!file.open(QFile::ReadOnly))
+		return presets;
+
+	QJsonParseError error;
+	QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+	if (error.error != QJsonParseError::NoError) {
+		std::cerr << "Could not read " << path.toStdString() << ": "
+				  << error.errorString().toStdString() << std::endl;
+		return presets;
+	}
+
+	for (const QJsonValue& value : doc.object()["presets"].toArray()) {
+		Preset preset;
+		if (fromJson(value.toObject(), preset))
+			presets.push_back(preset);
+	}
+	return presets;
+}
+
+bool Preset::save(const QString& path, const std::vector<Preset>& presets) {
+	QDir dir = QFileInfo(path).dir();
+	if (!dir.exists() && !dir.mkpath(".")) {
+		std::cerr << "Could not create config directory!" << std::endl;
+		return false;
+	}
+	QSaveFile file(path);
+	if (!file.open(QFile::WriteOnly)) {
+		std::cerr << "Could not open " << path.toStdString() << " for writing!" << std::endl;
+		return false;
+	}
+
+	QJsonArray list;
+	for (const Preset& preset : presets)
+		list.append(preset.toJson());
+	file.write(QJsonDocument(QJsonObject{{"presets", list}}).toJson());
+	return file.commit();
+}
@@ -0,0 +1,39 @@
+#ifndef PRESET_H
+#define PRESET_H
+
+#include <QJsonObject>
+#include <QString>
+#include <pulse/pulseaudio.h>
+#include <string>
+#include <vector>
+// preset.h: a named snapshot of the default sink, sink volumes and card profiles. PAManager
+// keeps them in presets.json and applies one by changing only what differs from the current state
+
+struct Preset {
+	struct SinkSetting {
+		std::string name;
+		pa_cvolume volume;
+		bool mute;
+	};
+	struct CardSetting {
+		std::string name;
+		std::string profile;
+	};
+
+	QString name;
+	std::string defaultSink;
+	std::string defaultSinkCard; // card the default sink belongs to, empty if it has none
+	std::vector<SinkSetting> sinks;
+	std::vector<CardSetting> cards;
+
+	QJsonObject toJson() const;
+	// false if obj isn't a usable preset
+	static bool fromJson(const QJsonObject& obj, Preset& preset);
+
+	// an empty list if there is no file yet
+	static std::vector<Preset> load(const QString& path);
+	// replaces the file in one go, so it's never left half written
+	static bool save(const QString& path, const std::vector<Preset>& presets);
+};
+
+#endif // PRESET_H
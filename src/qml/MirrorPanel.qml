@@ -0,0 +1,113 @@
+import QtQuick 6.0
+import QtQuick.Controls 6.0
+
+Popup {
+    id: panel
+    modal: true
+    padding: 30
+
+    property var mirror: pulse.mirror
+
+    background: Rectangle{
+        color: "#292C32"
+        radius: 15
+        border.color: "gray"
+        border.width: 3
+    }
+
+    HeaderText{
+        id: mirrorText
+        text: "Audio Mirroring"
+        anchors.horizontalCenter: parent.horizontalCenter
+    }
+
+    Button{
+        anchors.right: parent.right
+        anchors.verticalCenter: mirrorText.verticalCenter
+        height: 60
+        font.pointSize: 30
+        text: "Close"
+        onClicked: panel.close()
+    }
+
+    Switch{
+        id: enableSwitch
+        anchors.top: mirrorText.bottom
+        anchors.topMargin: 30
+        anchors.left: parent.left
+        font.pointSize: 30
+        text: "<font color=\"white\">Mirror the default output</font>"
+        checked: mirror.enabled
+        onToggled: mirror.enabled = checked
+    }
+
+    HeaderText{
+        id: latencyText
+        anchors.top: enableSwitch.bottom
+        anchors.topMargin: 30
+        anchors.left: parent.left
+        font.pointSize: 30
+        text: "Latency: " + latencySlider.value + " ms"
+    }
+
+    Slider{
+        id: latencySlider
+        anchors.left: latencyText.right
+        anchors.leftMargin: 30
+        anchors.right: parent.right
+        anchors.verticalCenter: latencyText.verticalCenter
+        from: 5
+        to: 200
+        stepSize: 5
+        snapMode: Slider.SnapAlways
+        value: mirror.latency
+        // restarting the engine on every step would just produce clicks
+        onPressedChanged: { if (!pressed) mirror.latency = value }
+    }
+
+    HeaderText{
+        id: statsText
+        anchors.top: latencyText.bottom
+        anchors.topMargin: 20
+        anchors.left: parent.left
+        font.pointSize: 25
+        color: "#bdbebf"
+        text: "Underruns: " + mirror.underruns + "   Overruns: " + mirror.overruns
+              + "   Drift: " + mirror.driftPpm + " ppm"
+    }
+
+    HeaderText{
+        id: targetText
+        anchors.top: statsText.bottom
+        anchors.topMargin: 30
+        anchors.left: parent.left
+        font.pointSize: 30
+        text: "Also play on:"
+    }
+
+    ListView{
+        anchors.top: targetText.bottom
+        anchors.topMargin: 20
+        anchors.bottom: parent.bottom
+        width: parent.width
+        clip: true
+        spacing: 10
+        model: pulse.sinks
+        boundsBehavior: Flickable.StopAtBounds
+
+        ScrollBar.vertical: ScrollBar{
+            policy: ScrollBar.AsNeeded
+            width: 20
+        }
+
+        delegate: CheckBox{
+            width: ListView.view.width - 40
+            font.pointSize: 30
+            text: "<font color=\"white\">" + description + "</font>"
+            // the default output is the one being mirrored
+            enabled: index != pulse.sinkIndex
+            checked: mirror.targets.indexOf(name) != -1
+            onToggled: mirror.setTarget(name, checked)
+        }
+    }
+}
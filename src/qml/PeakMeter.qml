@@ -0,0 +1,30 @@
+import QtQuick 6.0
+
+// one bar per channel of the default sink, fed by pulse.meter
+Row {
+    id: meter
+    property var levels: pulse.meter.peaks
+    property int barHeight: 80
+
+    spacing: 6
+    visible: pulse.meter.active
+
+    Repeater{
+        model: meter.levels.length
+        Rectangle{
+            width: 14
+            height: meter.barHeight
+            radius: 2
+            color: "#bdbebf"
+
+            Rectangle{
+                property real level: Math.min(1, meter.levels[index])
+                anchors.bottom: parent.bottom
+                width: parent.width
+                height: level * parent.height
+                radius: 2
+                color: level > 0.95 ? "#e53935" : level > 0.7 ? "#fdd835" : "#21be2b"
+            }
+        }
+    }
+}
@@ -0,0 +1,138 @@
+import QtQuick 6.0
+import QtQuick.Controls 6.0
+
+Popup {
+    id: mixer
+    modal: true
+    padding: 30
+
+    background: Rectangle{
+        color: "#292C32"
+        radius: 15
+        border.color: "gray"
+        border.width: 3
+    }
+
+    HeaderText{
+        id: mixerText
+        text: "Applications"
+        anchors.horizontalCenter: parent.horizontalCenter
+    }
+
+    Button{
+        id: closeButton
+        anchors.right: parent.right
+        anchors.verticalCenter: mixerText.verticalCenter
+        height: 60
+        font.pointSize: 30
+        text: "Close"
+        onClicked: mixer.close()
+    }
+
+    HeaderText{
+        anchors.centerIn: parent
+        visible: pulse.streams.count == 0
+        font.pointSize: 30
+        color: "#bdbebf"
+        text: "Nothing is playing"
+    }
+
+    // only the rows on screen get delegates, so lots of streams stay cheap
+    ListView{
+        id: streamList
+        anchors.top: mixerText.bottom
+        anchors.topMargin: 30
+        anchors.bottom: parent.bottom
+        width: parent.width
+        clip: true
+        spacing: 20
+        model: pulse.streams
+        boundsBehavior: Flickable.StopAtBounds
+        reuseItems: true
+
+        ScrollBar.vertical: ScrollBar{
+            policy: ScrollBar.AsNeeded
+            width: 20
+        }
+
+        delegate: Item{
+            width: streamList.width - 40
+            height: 120
+
+            ToolButton{
+                id: appIcon
+                anchors.left: parent.left
+                anchors.verticalCenter: parent.verticalCenter
+                icon.name: iconName
+                icon.width: 80
+                icon.height: 80
+                display: AbstractButton.IconOnly
+                enabled: false
+            }
+
+            Column{
+                id: appLabel
+                anchors.left: appIcon.right
+                anchors.leftMargin: 20
+                anchors.verticalCenter: parent.verticalCenter
+                width: 450
+                HeaderText{
+                    width: parent.width
+                    elide: Text.ElideRight
+                    font.pointSize: 30
+                    text: name
+                }
+                HeaderText{
+                    width: parent.width
+                    elide: Text.ElideRight
+                    font.pointSize: 20
+                    color: "#bdbebf"
+                    visible: title != ""
+                    text: title
+                }
+            }
+
+            VolumeSlider{
+                id: streamSlider
+                anchors.left: appLabel.right
+                anchors.leftMargin: 20
+                anchors.right: muteButton.left
+                anchors.rightMargin: 20
+                anchors.verticalCenter: parent.verticalCenter
+                from: 0
+                to: 100
+                value: volume
+                onMoved: pulse.setStreamVolume(streamIndex, value)
+            }
+
+            Button{
+                id: muteButton
+                anchors.right: sinkSelect.left
+                anchors.rightMargin: 20
+                anchors.verticalCenter: parent.verticalCenter
+                height: 60
+                font.pointSize: 25
+                checkable: true
+                checked: muted
+                text: muted ? "Unmute" : "Mute"
+                onClicked: pulse.setStreamMute(streamIndex, checked)
+            }
+
+            VRComboBox{
+                id: sinkSelect
+                anchors.right: parent.right
+                anchors.verticalCenter: parent.verticalCenter
+                width: 500
+                font.pointSize: 25
+                model: pulse.sinks
+                textRole: "description"
+                // depends on the sink count too, since sink positions move when sinks go away
+                currentIndex: {
+                    pulse.sinks.count
+                    return pulse.sinkPosition(sink)
+                }
+                onActivated: (i) => pulse.moveStream(streamIndex, i)
+            }
+        }
+    }
+}
@@ -52,7 +52,8 @@ ComboBox{
     delegate: ItemDelegate{
         id: del
         width: dropdown.width
-        text: modelData
+        // models from pulse have named roles, plain lists only have modelData
+        text: dropdown.textRole ? model[dropdown.textRole] : modelData
         font.pointSize: 30
         font.bold: (dropdown.currentIndex == index)
         font.family: dropdown.font.family
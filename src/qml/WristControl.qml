@@ -0,0 +1,51 @@
+import QtQuick 6.0
+import QtQuick.Controls 6.0
+
+// the wrist overlay: just the default output's volume and mute, without opening the dashboard
+Page {
+    width: screenWidth
+    height: screenHeight
+    background: Rectangle{
+        anchors.fill: parent
+        radius: 30
+        color: "#292C32"
+    }
+
+    VolumeSlider {
+        id: slider
+        anchors.left: parent.left
+        anchors.leftMargin: 20
+        anchors.right: muteButton.left
+        anchors.rightMargin: 20
+        anchors.verticalCenter: muteButton.verticalCenter
+
+        from: 0
+        to: 100
+
+        Component.onCompleted: {
+            pulse.newDefaultSink.connect(volUpdate)
+            pulse.volumeChanged.connect(volUpdate)
+            volUpdate()
+        }
+        onMoved: pulse.changeVol(value)
+        function volUpdate(){
+            // don't fight the user while they're dragging
+            if (!pressed)
+                value = pulse.volume
+        }
+    }
+
+    Button{
+        id: muteButton
+        anchors.right: parent.right
+        anchors.rightMargin: 20
+        anchors.verticalCenter: parent.verticalCenter
+        height: 100
+        width: 160
+        font.pointSize: 25
+        checkable: true
+        checked: pulse.muted
+        text: pulse.muted ? "Unmute" : "Mute"
+        onClicked: pulse.setMute(checked)
+    }
+}
@@ -23,6 +23,46 @@ Page {
         }
     }
 
+    Button{
+        id: mixerButton
+        anchors.top: parent.top
+        anchors.topMargin: 30
+        anchors.right: parent.right
+        anchors.rightMargin: 30
+        height: 60
+        font.pointSize: 30
+        text: "Applications (" + pulse.streams.count + ")"
+        onClicked: streamMixer.open()
+    }
+
+    Button{
+        id: mirrorButton
+        anchors.top: parent.top
+        anchors.topMargin: 30
+        anchors.left: parent.left
+        anchors.leftMargin: 30
+        height: 60
+        font.pointSize: 30
+        text: pulse.mirror.enabled ? "Mirroring (on)" : "Mirroring"
+        onClicked: mirrorPanel.open()
+    }
+
+    MirrorPanel{
+        id: mirrorPanel
+        x: 20
+        y: 20
+        width: screenWidth - 40
+        height: screenHeight - 40
+    }
+
+    StreamMixer{
+        id: streamMixer
+        x: 20
+        y: 20
+        width: screenWidth - 40
+        height: screenHeight - 40
+    }
+
     HeaderText{
         id: sinkText
         text: "Default Output"
@@ -37,17 +77,11 @@ Page {
         anchors.topMargin: 20
         anchors.horizontalCenter: sinkText.horizontalCenter
 
-        width: 1300
+        width: Math.min(1300, screenWidth - 500)
         model: pulse.sinks
-        property bool ready: false
-        onCurrentIndexChanged: {
-            // avoid changing sink on startup
-            if (!ready){
-                ready = true
-                return
-            }
-            pulse.changeSink(currentIndex)
-        }
+        textRole: "description"
+        // only user picks change the sink, not index updates from pulse
+        onActivated: (index) => pulse.changeSink(index)
         Component.onCompleted:{
             setIndex()
             pulse.newDefaultSink.connect(setIndex)
@@ -70,14 +104,24 @@ Page {
 
         Component.onCompleted: {
             pulse.newDefaultSink.connect(volUpdate)
+            pulse.volumeChanged.connect(volUpdate)
             volUpdate()
         }
-        onValueChanged: pulse.changeVol(value)
+        onMoved: pulse.changeVol(value)
         function volUpdate(){
-            value = pulse.getVolPct()
+            // don't fight the user while they're dragging
+            if (!pressed)
+                value = pulse.volume
         }
     }
 
+    PeakMeter{
+        id: peakMeter
+        anchors.left: slider.right
+        anchors.leftMargin: 30
+        anchors.verticalCenter: slider.verticalCenter
+    }
+
     Button{
 	id: configButton
         anchors.top: slider.bottom
@@ -86,14 +130,7 @@ Page {
         font.pointSize: 30
         anchors.horizontalCenter: slider.horizontalCenter
         text: "Save config"
-	onClicked: {
-	    configFeedback.visible = true
-	    if (pulse.saveConfig())
-		configFeedback.text = "Config saved successfully!"
-	    else
-		configFeedback.text = "Config was not saved due to an error!"
-	    configFeedbackTimer.start()
-	}
+	onClicked: pulse.saveConfig()
     }
     HeaderText{
 	id: configFeedback
@@ -125,6 +162,49 @@ Page {
         anchors.horizontalCenter: separator.horizontalCenter
     }
 
+    BusyIndicator{
+        id: pendingIndicator
+        height: configText.height
+        width: height
+        anchors.left: configText.right
+        anchors.leftMargin: 20
+        anchors.verticalCenter: configText.verticalCenter
+        running: pulse.pendingOperations > 0 || !pulse.ready
+    }
+
+    Connections{
+        target: pulse
+        function onOperationFinished(kind, success) {
+            // saving may have to fetch the cards first, so its result comes in here too
+            if (kind === "save-config") {
+                configFeedback.visible = true
+                configFeedback.text = success ? "Config saved successfully!"
+                                              : "Config was not saved due to an error!"
+                configFeedbackTimer.restart()
+                return
+            }
+            // a failed volume change is corrected by the next update anyway
+            if (success || kind === "volume" || kind === "stream volume")
+                return
+            configFeedback.visible = true
+            if (kind === "stream move" || kind === "stream mute")
+                configFeedback.text = "Could not change the application's stream!"
+            else if (kind === "profile")
+                configFeedback.text = "Could not change the device profile!"
+            else if (kind === "mute")
+                configFeedback.text = "Could not mute the output device!"
+            else if (kind === "sink")
+                configFeedback.text = "Could not change the output device!"
+            else if (kind === "preset")
+                configFeedback.text = "Could not apply all of the preset!"
+            else if (kind === "cards")
+                configFeedback.text = "Could not read the sound cards!"
+            else
+                configFeedback.text = "Could not apply the saved config!"
+            configFeedbackTimer.restart()
+        }
+    }
+
     HeaderText{
         id: cardText
         text: "Device"
@@ -135,19 +215,14 @@ Page {
 
     VRComboBox{
         id: cardDropdown
-        width: 1000
+        width: Math.min(1000, (screenWidth - 100) / 2)
 
         anchors.top: cardText.bottom
         anchors.topMargin: 20
         anchors.left: parent.left
         anchors.leftMargin: 30
-        model: {
-            var l = []
-            for (var i = 0; i<pulse.cards.length; i++){
-                l.push(pulse.cards[i].description)
-            }
-            return l
-        }
+        model: pulse.cards
+        textRole: "description"
     }
 
     HeaderText{
@@ -159,24 +234,84 @@ Page {
     VRComboBox{
         id: profileDropdown
         y: cardDropdown.y
-        width: 1000
+        width: cardDropdown.width
 
         anchors.right: parent.right
         anchors.rightMargin: cardDropdown.anchors.leftMargin
-        model: pulse.cards[currentCardIndex].profiles
-        property bool userChange: false
-        onCurrentIndexChanged: {
-            if (userChange){
-                var currentCard = pulse.cards[currentCardIndex]
-                var currentProfile = currentCard.profiles[currentProfileIndex]
-                pulse.changeCardProfile(currentCard, currentProfile)
+        // depends on pulse.cards.count too, so a hot-plug picks up the card at this row again
+        property var currentCard: {
+            pulse.cards.count
+            return pulse.cards.get(currentCardIndex)
+        }
+        model: currentCard ? currentCard.profiles : null
+        textRole: "description"
+        onActivated: (index) => pulse.changeCardProfile(currentCard, textAt(index))
+        onModelChanged: setIndex()
+
+        function setIndex(){
+            if (currentCard)
+                currentIndex = currentCard.activeProfileIndex
+        }
+
+        Connections{
+            target: profileDropdown.currentCard
+            function onActiveProfileChanged() { profileDropdown.setIndex() }
+        }
+    }
+
+    // one tap applies a preset, holding it saves the current setup into it
+    Row{
+        id: presetRow
+        anchors.top: cardDropdown.bottom
+        anchors.topMargin: 40
+        anchors.horizontalCenter: parent.horizontalCenter
+        spacing: 20
+
+        Repeater{
+            model: pulse.presets
+            Button{
+                height: 60
+                font.pointSize: 25
+                text: modelData
+                onClicked: pulse.applyPreset(modelData)
+                onPressAndHold: presetRow.save(modelData)
             }
-            userChange = false
         }
-        onPressedChanged: { if (pressed) userChange = true }
-        onModelChanged: {
-            currentIndex = pulse.cards[currentCardIndex].activeProfileIndex
+
+        Button{
+            height: 60
+            font.pointSize: 25
+            text: "+"
+            onClicked: {
+                var n = pulse.presets.length + 1
+                while (pulse.presets.indexOf("Preset " + n) !== -1)
+                    n++
+                presetRow.save("Preset " + n)
+            }
         }
+
+        function save(name){
+            configFeedback.visible = true
+            if (pulse.savePreset(name))
+                configFeedback.text = name + " saved!"
+            else
+                configFeedback.text = name + " was not saved due to an error!"
+            configFeedbackTimer.restart()
+        }
+    }
+
+    // --stats-hud
+    Text{
+        id: statsHud
+        anchors.left: parent.left
+        anchors.leftMargin: 20
+        anchors.bottom: parent.bottom
+        anchors.bottomMargin: 20
+        visible: stats.hud
+        text: stats.summary
+        font.family: "monospace"
+        font.pointSize: 14
+        color: "#bdbebf"
     }
 
 }
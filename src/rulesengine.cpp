@@ -0,0 +1,97 @@
+#include "rulesengine.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <iostream>
+
+RulesEngine RulesEngine::load(const QString& path) {
+	RulesEngine engine;
+	QFile file(path);
+	if (!file.open(QFile::ReadOnly))
+		return engine;
+
+	QJsonParseError error;
+	QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+	if (error.error != QJsonParseError::NoError) {
+		std::cerr << "Could not read " << path.toStdString() << ": "
+				  << error.errorString().toStdString() << std::endl;
+		return engine;
+	}
+
+	for (const QJsonValue& value : doc.object()["rules"].toArray()) {
+		QJsonObject obj = value.toObject();
+		Rule rule;
+		rule.name = obj["name"].toString();
+		rule.target = (obj["when"].toString() == "sink") ? Target::Sink : Target::Card;
+		rule.deviceName = obj["device"].toString().toStdString();
+		rule.property = obj["property"].toString().toStdString();
+		rule.value = obj["value"].toString().toStdString();
+		rule.profile = obj["profile"].toString().toStdString();
+		rule.sink = obj["sink"].toString().toStdString();
+		rule.volume = std::clamp(obj["volume"].toInt(-1), -1, 100);
+
+		if (rule.deviceName.empty() && rule.property.empty()) {
+			std::clog << "Skipping rule " << rule.name.toStdString()
+					  << ", it needs a device or a property to match" << std::endl;
+			continue;
+		}
+		engine.add(rule);
+	}
+	std::clog << "Loaded " << engine.rules.size() << " device rules" << std::endl;
+	return engine;
+}
+
+void RulesEngine::add(const Rule& rule) {
+	int i = rules.size();
+	rules.push_back(rule);
+
+	// emplace keeps the first rule for a key, the same one a linear search would find
+	Index& index = indexes[int(rule.target)];
+	if (!rule.deviceName.empty()) {
+		index.byName[rule.deviceName].push_back(i);
+		return;
+	}
+	index.byProperty.emplace(rule.property + '=' + rule.value, i);
+	if (std::find(index.properties.begin(), index.properties.end(), rule.property)
+			== index.properties.end())
+		index.properties.push_back(rule.property);
+}
+
+bool RulesEngine::empty() const { return rules.empty(); }
+
+const RulesEngine::Rule& RulesEngine::rule(int i) const { return rules[i]; }
+
+int RulesEngine::match(Target target, const char* name, const pa_proplist* props) const {
+	const Index& index = indexes[int(target)];
+	int found = -1;
+	auto consider = [&found](int i) { found = (found == -1) ? i : std::min(found, i); };
+
+	if (name) {
+		auto it = index.byName.find(name);
+		if (it != index.byName.end()) {
+			// in file order, so the first one whose property matches as well wins
+			for (int i : it->second) {
+				const Rule& rule = rules[i];
+				if (!rule.property.empty()) {
+					const char* value = pa_proplist_gets(props, rule.property.c_str());
+					if (!value || rule.value != value)
+						continue;
+				}
+				consider(i);
+				break;
+			}
+		}
+	}
+	for (const std::string& key : index.properties) {
+		const char* value = pa_proplist_gets(props, key.c_str());
+		if (!value)
+			continue;
+		auto it = index.byProperty.find(key + '=' + value);
+		if (it != index.byProperty.end())
+			consider(it->second);
+	}
+	return found;
+}
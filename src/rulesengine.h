@@ -0,0 +1,54 @@
+#ifndef RULESENGINE_H
+#define RULESENGINE_H
+
+#include <QString>
+#include <pulse/pulseaudio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+// rulesengine.h: what to do when a device is plugged in, e.g. "when this card appears, switch it
+// to that profile and make its sink the default". rules are indexed once when they're loaded, so
+// matching a new device is a few hash lookups on the info its subscription event fetched anyway
+
+class RulesEngine {
+  public:
+	enum class Target { Card, Sink };
+
+	struct Rule {
+		QString name; // for the log
+		Target target = Target::Card;
+		// the device's name, one of its proplist entries, or both
+		std::string deviceName;
+		std::string property;
+		std::string value;
+		// actions. for cards, sink is the sink to make the default, by default whichever one the
+		// profile gives the card. sink rules make the matched sink the default
+		std::string profile;
+		std::string sink;
+		int volume = -1; // percent, -1 leaves it alone
+	};
+
+	// empty if there is no file, rules that can't match anything are skipped
+	static RulesEngine load(const QString& path);
+
+	bool empty() const;
+	const Rule& rule(int i) const;
+	// the first rule in the file matching the device, -1 if there is none. doesn't change after
+	// loading, so it's safe to call from the mainloop thread
+	int match(Target target, const char* name, const pa_proplist* props) const;
+
+  private:
+	std::vector<Rule> rules;
+
+	struct Index {
+		// rules with a property too are only a candidate, so every rule for a name is kept
+		std::unordered_map<std::string, std::vector<int>> byName;
+		std::unordered_map<std::string, int> byProperty; // key=value
+		std::vector<std::string> properties;             // keys any rule looks at
+	};
+	Index indexes[2]; // by Target
+
+	void add(const Rule& rule);
+};
+
+#endif // RULESENGINE_H
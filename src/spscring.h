@@ -0,0 +1,74 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+// spscring.h: fixed size lock-free ring for handing items from exactly one producer thread to
+// exactly one consumer thread, e.g. from the pulseaudio mainloop to the GUI
+
+template <typename T, std::size_t N>
+class SpscRing {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "ring size has to be a power of two");
+
+  public:
+	// producer only. returns false and drops the item if the consumer fell behind
+	bool push(const T& item) {
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == N)
+			return false;
+
+		items[h & (N - 1)] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only. returns false if there was nothing to take
+	bool pop(T& item) {
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+			return false;
+
+		item = items[t & (N - 1)];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// producer only. copies up to count items, returns how many fit
+	std::size_t write(const T* data, std::size_t count) {
+		std::size_t h = head.load(std::memory_order_relaxed);
+		std::size_t n = std::min(count, N - (h - tail.load(std::memory_order_acquire)));
+		for (std::size_t i = 0; i < n; i++)
+			items[(h + i) & (N - 1)] = data[i];
+		head.store(h + n, std::memory_order_release);
+		return n;
+	}
+
+	// consumer only. copies up to count items, returns how many there were
+	std::size_t read(T* data, std::size_t count) {
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		std::size_t n = std::min(count, head.load(std::memory_order_acquire) - t);
+		for (std::size_t i = 0; i < n; i++)
+			data[i] = items[(t + i) & (N - 1)];
+		tail.store(t + n, std::memory_order_release);
+		return n;
+	}
+
+	// consumer only. drops everything that's currently in the ring
+	void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+
+	// only exact while neither side is running
+	std::size_t size() const {
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+	static constexpr std::size_t capacity() { return N; }
+
+  private:
+	std::array<T, N> items{};
+	// own cache lines, so the two threads don't keep stealing them from each other
+	alignas(64) std::atomic<std::size_t> head{0};
+	alignas(64) std::atomic<std::size_t> tail{0};
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,188 @@
+#include "stats.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+constexpr int hudInterval = 1000; // ms
+constexpr const char* sectionNames[Stats::SectionCount] = {
+		"render", "pollEvents", "transitionImageLayout"};
+} // namespace
+
+Stats* Stats::current = nullptr;
+
+void Stats::Histogram::add(qint64 ns) {
+	qint64 us = ns / 1000;
+	int bucket = 0;
+	while (us > 1 && bucket < bucketCount - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	buckets[bucket]++;
+	count++;
+	sumNs += ns;
+	maxNs = std::max(maxNs, ns);
+}
+
+qint64 Stats::Histogram::quantileUs(double q) const {
+	if (count == 0)
+		return 0;
+
+	quint64 rank = std::max<quint64>(1, quint64(q * count + 0.5));
+	quint64 seen = 0;
+	for (int i = 0; i < bucketCount; i++) {
+		seen += buckets[i];
+		if (seen >= rank)
+			return std::min(qint64(1) << (i + 1), maxNs / 1000 + 1);
+	}
+	return maxNs / 1000 + 1;
+}
+
+QJsonObject Stats::Histogram::toJson() const {
+	// trailing empty buckets are left out
+	int used = bucketCount;
+	while (used > 0 && buckets[used - 1] == 0)
+		used--;
+	QJsonArray b;
+	for (int i = 0; i < used; i++)
+		b.append(qint64(buckets[i]));
+
+	return {
+			{"count", qint64(count)},
+			{"meanUs", count ? double(sumNs) / count / 1000.0 : 0.0},
+			{"maxUs", maxNs / 1000.0},
+			{"p50Us", quantileUs(0.5)},
+			{"p90Us", quantileUs(0.9)},
+			{"p99Us", quantileUs(0.99)},
+			{"log2UsBuckets", b},
+	};
+}
+
+Stats::Stats(QObject* parent) : QObject(parent), hud(false), startedNs(now()) {
+	current = this;
+	connect(&dumpTimer, SIGNAL(timeout()), this, SLOT(dump()));
+	hudTimer.setInterval(hudInterval);
+	connect(&hudTimer, SIGNAL(timeout()), this, SLOT(updateSummary()));
+}
+
+Stats::~Stats() {
+	active.store(false);
+	current = nullptr;
+}
+
+Stats* Stats::instance() { return current; }
+
+void Stats::enable(const QString& p, int dumpInterval, bool showHud) {
+	path = p;
+	hud = showHud;
+	active.store(true);
+
+	dumpTimer.start(dumpInterval);
+	// once more on the way out, while everything the sources look at still exists
+	connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(dump()));
+	if (hud)
+		hudTimer.start();
+}
+
+void Stats::record(Section section, qint64 ns) {
+	std::lock_guard guard(lock);
+	sections[section].add(ns);
+}
+
+void Stats::recordOp(const QString& kind, qint64 ns) {
+	std::lock_guard guard(lock);
+	ops[kind].add(ns);
+}
+
+void Stats::recordOnce(const QString& name, qint64 ns) {
+	if (!current)
+		return;
+	std::lock_guard guard(current->lock);
+	current->once[name] = ns;
+}
+
+void Stats::addSource(const QString& name, std::function<QJsonObject()> source) {
+	sources.emplace_back(name, std::move(source));
+}
+
+QJsonObject Stats::toJson() const {
+	QJsonObject root;
+	root["uptimeS"] = (now() - startedNs) / 1e9;
+
+	{
+		std::lock_guard guard(lock);
+		QJsonObject s;
+		for (int i = 0; i < SectionCount; i++)
+			s[sectionNames[i]] = sections[i].toJson();
+		root["sections"] = s;
+
+		QJsonObject o;
+		for (const auto& [kind, hist] : ops)
+			o[kind] = hist.toJson();
+		root["operations"] = o;
+
+		QJsonObject t;
+		for (const auto& [name, ns] : once)
+			t[name + "Ms"] = ns / 1e6;
+		root["timings"] = t;
+	}
+
+	for (const auto& [name, source] : sources)
+		root[name] = source();
+	return root;
+}
+
+bool Stats::dump() {
+	QDir dir = QFileInfo(path).dir();
+	if (!dir.exists() && !dir.mkpath(".")) {
+		std::cerr << "Could not create stats directory!" << std::endl;
+		return false;
+	}
+
+	// written in one go, so anything watching the file never sees half of it
+	QSaveFile file(path);
+	if (!file.open(QFile::WriteOnly)) {
+		std::cerr << "Could not open " << path.toStdString() << " for writing!" << std::endl;
+		return false;
+	}
+	file.write(QJsonDocument(toJson()).toJson());
+	return file.commit();
+}
+
+bool Stats::hudEnabled() const { return hud; }
+
+QString Stats::getSummary() const { return summary; }
+
+void Stats::updateSummary() {
+	QString text;
+	{
+		std::lock_guard guard(lock);
+		for (int i = 0; i < SectionCount; i++) {
+			const Histogram& h = sections[i];
+			text += QString("%1: %2 p50 %3 p99 %4 us\n")
+							.arg(sectionNames[i])
+							.arg(h.count)
+							.arg(h.quantileUs(0.5))
+							.arg(h.quantileUs(0.99));
+		}
+		for (const auto& [kind, h] : ops)
+			text += QString("%1: %2 p50 %3 p99 %4 us\n")
+							.arg(kind)
+							.arg(h.count)
+							.arg(h.quantileUs(0.5))
+							.arg(h.quantileUs(0.99));
+	}
+	text.chop(1);
+
+	if (text == summary)
+		return;
+	summary = text;
+	emit summaryChanged();
+}
@@ -0,0 +1,111 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <QJsonObject>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+// stats.h: optional counters and latency histograms for the hot paths, see --stats. while
+// disabled every hook is a single check of Stats::enabled()
+
+class Stats : public QObject {
+	Q_OBJECT
+	Q_PROPERTY(bool hud READ hudEnabled CONSTANT)
+	Q_PROPERTY(QString summary READ getSummary NOTIFY summaryChanged)
+  public:
+	// the timed sections of the render loop
+	enum Section { Render, PollEvents, Transition, SectionCount };
+
+	// durations bucketed by powers of two, bucket i holds [2^i, 2^(i+1)) microseconds
+	struct Histogram {
+		static constexpr int bucketCount = 24; // up to ~8 s
+		std::array<quint64, bucketCount> buckets{};
+		quint64 count = 0;
+		qint64 sumNs = 0;
+		qint64 maxNs = 0;
+
+		void add(qint64 ns);
+		// upper bound of the bucket the q-th quantile falls into, in microseconds
+		qint64 quantileUs(double q) const;
+		QJsonObject toJson() const;
+	};
+
+	explicit Stats(QObject* parent = nullptr);
+	~Stats();
+
+	// the Stats object made in main(), or nullptr
+	static Stats* instance();
+	// set on the GUI thread while the other threads run, they read it relaxed
+	static inline std::atomic<bool> active{false};
+	static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+	static qint64 now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch())
+				.count();
+	}
+
+	// start collecting, dumping to path every dumpInterval ms
+	void enable(const QString& path, int dumpInterval, bool hud);
+
+	void record(Section section, qint64 ns);
+	// round trip of a PAManager operation, by its kind
+	void recordOp(const QString& kind, qint64 ns);
+	// one off durations, like startup phases. kept even without --stats, they're cheap
+	static void recordOnce(const QString& name, qint64 ns);
+	// extra data for the dump, collected on the GUI thread when dumping
+	void addSource(const QString& name, std::function<QJsonObject()> source);
+
+	QJsonObject toJson() const;
+	bool hudEnabled() const;
+	QString getSummary() const;
+
+	// times a scope into one of the sections
+	class Timer {
+	  public:
+		explicit Timer(Section s) : section(s), start(enabled() ? now() : 0) {}
+		~Timer() {
+			if (start && enabled())
+				instance()->record(section, now() - start);
+		}
+
+	  private:
+		Section section;
+		qint64 start;
+	};
+
+  public slots:
+	bool dump();
+
+  signals:
+	void summaryChanged();
+
+  private slots:
+	void updateSummary();
+
+  private:
+	static Stats* current;
+
+	QString path;
+	bool hud;
+	qint64 startedNs;
+	QTimer dumpTimer;
+	QTimer hudTimer;
+	QString summary;
+
+	// the render loop and PAManager can end up on different threads
+	mutable std::mutex lock;
+	std::array<Histogram, SectionCount> sections;
+	std::map<QString, Histogram> ops;
+	std::map<QString, qint64> once;
+	std::vector<std::pair<QString, std::function<QJsonObject()>>> sources;
+};
+
+#endif // STATS_H
@@ -0,0 +1,102 @@
+#include "streammodel.h"
+
+#include "devicemodels.h"
+
+StreamModel::StreamModel(QObject* parent) : QAbstractListModel(parent) {}
+
+int StreamModel::rowCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return streams.size();
+}
+
+QVariant StreamModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid() || index.row() >= streams.size())
+		return {};
+
+	const StreamInfo& s = streams[index.row()];
+	switch (role) {
+	case StreamIndexRole:
+		return s.index;
+	case NameRole:
+		return s.name;
+	case TitleRole:
+		return s.title;
+	case IconNameRole:
+		return s.iconName;
+	case VolumeRole:
+		return volumePct(s.volume);
+	case MutedRole:
+		return s.mute;
+	case SinkRole:
+		return s.sink;
+	default:
+		return {};
+	}
+}
+
+QHash<int, QByteArray> StreamModel::roleNames() const {
+	return {
+			{StreamIndexRole, "streamIndex"},
+			{NameRole, "name"},
+			{TitleRole, "title"},
+			{IconNameRole, "iconName"},
+			{VolumeRole, "volume"},
+			{MutedRole, "muted"},
+			{SinkRole, "sink"},
+	};
+}
+
+void StreamModel::update(const StreamInfo& info) {
+	int row = rowOf(info.index);
+	if (row == -1) {
+		beginInsertRows(QModelIndex(), streams.size(), streams.size());
+		streams.push_back(info);
+		endInsertRows();
+		emit countChanged();
+		return;
+	}
+
+	StreamInfo& s = streams[row];
+	QList<int> roles;
+	if (s.name != info.name)
+		roles << NameRole;
+	if (s.title != info.title)
+		roles << TitleRole;
+	if (s.iconName != info.iconName)
+		roles << IconNameRole;
+	if (!pa_cvolume_equal(&s.volume, &info.volume))
+		roles << VolumeRole;
+	if (s.mute != info.mute)
+		roles << MutedRole;
+	if (s.sink != info.sink)
+		roles << SinkRole;
+	s = info;
+
+	if (!roles.isEmpty())
+		emit dataChanged(this->index(row), this->index(row), roles);
+}
+
+void StreamModel::remove(uint32_t index) {
+	int row = rowOf(index);
+	if (row == -1)
+		return;
+
+	beginRemoveRows(QModelIndex(), row, row);
+	streams.erase(streams.begin() + row);
+	endRemoveRows();
+	emit countChanged();
+}
+
+const StreamInfo* StreamModel::find(uint32_t index) const {
+	int row = rowOf(index);
+	return (row == -1) ? nullptr : &streams[row];
+}
+
+int StreamModel::rowOf(uint32_t index) const {
+	for (int i = 0; i < streams.size(); i++) {
+		if (streams[i].index == index)
+			return i;
+	}
+	return -1;
+}
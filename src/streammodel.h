@@ -0,0 +1,56 @@
+#ifndef STREAMMODEL_H
+#define STREAMMODEL_H
+
+#include <QAbstractListModel>
+#include <QString>
+#include <pulse/pulseaudio.h>
+#include <vector>
+// streammodel.h: list model of all playback streams (sink inputs), for the per application mixer
+
+// plain copy of a pa_sink_input_info, safe to pass from the mainloop thread to the GUI thread
+struct StreamInfo {
+	uint32_t index;
+	uint32_t sink; // pulseaudio index of the sink the stream plays on
+	QString name;  // application name
+	QString title; // what the application says it's playing, may be empty
+	QString iconName;
+	pa_cvolume volume;
+	bool mute;
+};
+
+class StreamModel : public QAbstractListModel {
+	Q_OBJECT
+	Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+  public:
+	enum Roles {
+		StreamIndexRole = Qt::UserRole + 1,
+		NameRole,
+		TitleRole,
+		IconNameRole,
+		VolumeRole,
+		MutedRole,
+		SinkRole,
+	};
+
+	explicit StreamModel(QObject* parent = nullptr);
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex& index, int role) const override;
+	QHash<int, QByteArray> roleNames() const override;
+
+	// insert or patch a stream. only the roles that changed are signalled, so a
+	// volume change doesn't rebuild the whole row
+	void update(const StreamInfo& info);
+	void remove(uint32_t index);
+	const StreamInfo* find(uint32_t index) const;
+
+  signals:
+	void countChanged();
+
+  private:
+	std::vector<StreamInfo> streams;
+
+	int rowOf(uint32_t index) const;
+};
+
+#endif // STREAMMODEL_H
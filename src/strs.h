@@ -2,12 +2,25 @@
 #define STRS_H
 
 #include <QDir>
+#include <QStandardPaths>
 namespace strings {
 inline constexpr auto app_key = "supreme.vrdio";
 inline constexpr auto overlay_friendly_name = "Audio Control";
+inline constexpr auto wrist_overlay_key = "supreme.vrdio.wrist";
+inline constexpr auto wrist_overlay_friendly_name = "Audio Control (wrist)";
 inline auto config_dir_loc = QDir::homePath() + "/.config/vrdio";
 inline auto vrmanifest_loc = config_dir_loc + "/vrdio.vrmanifest";
 inline auto audioconfig_loc = config_dir_loc + "/audioconfig.txt";
+inline auto mirrorconfig_loc = config_dir_loc + "/mirrorconfig.txt";
+inline auto presets_loc = config_dir_loc + "/presets.json";
+inline auto rules_loc = config_dir_loc + "/rules.json";
+inline auto stats_loc = config_dir_loc + "/stats.json";
+inline auto trace_loc = config_dir_loc + "/trace.json";
+// $XDG_RUNTIME_DIR, only the user can get in there
+inline auto control_socket_loc =
+		QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + "/vrdio.sock";
+// set on vrdio's own playback streams
+inline constexpr auto mirror_prop = "vrdio.mirror";
 
 } // namespace strings
 
@@ -0,0 +1,115 @@
+#include "trace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+struct Event {
+	const char* name;
+	qint64 begin;
+	qint64 end;
+};
+
+// written by its own thread only. count is published after each event, so write() can read
+// the events before it while the thread keeps going
+struct Buffer {
+	long tid;
+	std::string thread;
+	std::unique_ptr<Event[]> events;
+	std::atomic<std::size_t> count{0};
+	std::atomic<quint64> dropped{0};
+};
+
+QString tracePath;
+qint64 traceStart = 0;
+std::mutex buffersLock;
+std::vector<std::unique_ptr<Buffer>> buffers;
+thread_local Buffer* threadBuffer = nullptr;
+
+Buffer* registerThread() {
+	auto buffer = std::make_unique<Buffer>();
+	buffer->tid = syscall(SYS_gettid);
+	char name[16] = {};
+	pthread_getname_np(pthread_self(), name, sizeof(name));
+	buffer->thread = name;
+	buffer->events = std::make_unique<Event[]>(Trace::eventsPerThread);
+
+	std::lock_guard guard(buffersLock);
+	buffers.push_back(std::move(buffer));
+	threadBuffer = buffers.back().get();
+	return threadBuffer;
+}
+
+// the trace viewers expect microseconds
+QByteArray us(qint64 ns) { return QByteArray::number(ns / 1000.0, 'f', 3); }
+} // namespace
+
+void Trace::enable(const QString& path) {
+	tracePath = path;
+	traceStart = Stats::now();
+	active.store(true);
+}
+
+void Trace::record(const char* name, qint64 begin, qint64 end) {
+	Buffer* buffer = threadBuffer ? threadBuffer : registerThread();
+	std::size_t n = buffer->count.load(std::memory_order_relaxed);
+	if (n == eventsPerThread) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	buffer->events[n] = {name, begin, end};
+	buffer->count.store(n + 1, std::memory_order_release);
+}
+
+bool Trace::write() {
+	QDir dir = QFileInfo(tracePath).dir();
+	if (!dir.exists() && !dir.mkpath(".")) {
+		std::cerr << "Could not create trace directory!" << std::endl;
+		return false;
+	}
+	QSaveFile file(tracePath);
+	if (!file.open(QFile::WriteOnly)) {
+		std::cerr << "Could not open " << tracePath.toStdString() << " for writing!" << std::endl;
+		return false;
+	}
+
+	std::lock_guard guard(buffersLock);
+	QByteArray pid = QByteArray::number(getpid());
+	file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const auto& buffer : buffers) {
+		QByteArray tid = QByteArray::number(qint64(buffer->tid));
+		QByteArray head = "{\"pid\":" + pid + ",\"tid\":" + tid;
+
+		// names the thread's track in the viewer
+		file.write(first ? "" : ",\n");
+		first = false;
+		file.write(head + ",\"ph\":\"M\",\"name\":\"thread_name\",\"args\":{\"name\":\""
+				   + QByteArray::fromStdString(buffer->thread) + "\"}}");
+
+		std::size_t count = buffer->count.load(std::memory_order_acquire);
+		for (std::size_t i = 0; i < count; i++) {
+			const Event& e = buffer->events[i];
+			file.write(",\n" + head + ",\"ph\":\"X\",\"name\":\"" + e.name + "\",\"ts\":"
+					   + us(e.begin - traceStart) + ",\"dur\":" + us(e.end - e.begin) + "}");
+		}
+
+		quint64 dropped = buffer->dropped.load(std::memory_order_relaxed);
+		if (dropped)
+			std::clog << "Trace buffer of thread " << buffer->tid << " was full, dropped "
+					  << dropped << " spans" << std::endl;
+	}
+	file.write("\n]}\n");
+	return file.commit();
+}
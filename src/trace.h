@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "stats.h"
+
+#include <QString>
+#include <atomic>
+#include <cstddef>
+// trace.h: opt-in span tracing, see --trace. every thread records into its own preallocated
+// buffer and the whole thing is written as a chrome://tracing / Perfetto JSON file on exit
+
+class Trace {
+  public:
+	// spans a thread can record, later ones are dropped and counted
+	static constexpr std::size_t eventsPerThread = 1 << 18;
+
+	// threads that are already running pick it up with their next span
+	static inline std::atomic<bool> active{false};
+	static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+	// start recording. spans are written to path by write()
+	static void enable(const QString& path);
+	static bool write();
+
+	// records the scope it lives in. name has to outlive the trace, so use string literals
+	class Span {
+	  public:
+		explicit Span(const char* n) : name(n), start(enabled() ? Stats::now() : 0) {}
+		~Span() { end(); }
+
+		// ends this span and starts the next one right after it, for consecutive phases
+		void next(const char* n) {
+			end();
+			name = n;
+			start = enabled() ? Stats::now() : 0;
+		}
+
+	  private:
+		const char* name;
+		qint64 start;
+
+		void end() {
+			if (start && enabled())
+				record(name, start, Stats::now());
+		}
+	};
+
+  private:
+	static void record(const char* name, qint64 begin, qint64 end);
+};
+
+#endif // TRACE_H
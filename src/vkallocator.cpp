@@ -0,0 +1,207 @@
+#include "vkallocator.h"
+
+#include <QVulkanFunctions>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+VkAllocator::VkAllocator(QVulkanInstance* instance, VkPhysicalDevice physicalDevice,
+		VkDevice dev, bool dedicatedAllocation)
+	: devFuncs(instance->deviceFunctions(dev)), device(dev), getRequirements2(nullptr) {
+	instance->functions()->vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+	if (dedicatedAllocation)
+		getRequirements2 = reinterpret_cast<PFN_vkGetImageMemoryRequirements2KHR>(
+				instance->getInstanceProcAddr("vkGetImageMemoryRequirements2KHR"));
+}
+
+VkAllocator::~VkAllocator() {
+	// everything still handed out goes with its block, dedicated allocations were freed with
+	// their images
+	for (Block& block : blocks) {
+		if (block.memory != VK_NULL_HANDLE)
+			devFuncs->vkFreeMemory(device, block.memory, nullptr);
+	}
+}
+
+int VkAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags wanted) const {
+	for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+		if ((typeBits & (1u << i)) && (memProps.memoryTypes[i].propertyFlags & wanted) == wanted)
+			return i;
+	}
+	return -1;
+}
+
+VkDeviceMemory VkAllocator::allocate(VkDeviceSize size, uint32_t type, VkImage dedicatedImage) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = type;
+
+	VkMemoryDedicatedAllocateInfoKHR dedicatedInfo{};
+	if (dedicatedImage != VK_NULL_HANDLE) {
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+		dedicatedInfo.image = dedicatedImage;
+		allocInfo.pNext = &dedicatedInfo;
+	}
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkResult result = devFuncs->vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate " + std::to_string(size >> 20)
+								 + " MiB of image memory (" + std::to_string(result) + ")");
+	stats.reserved += size;
+	return memory;
+}
+
+// first fit. the space skipped for alignment stays free
+bool VkAllocator::suballocate(
+		Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+	for (size_t i = 0; i < block.free.size(); i++) {
+		Range r = block.free[i];
+		VkDeviceSize start = (r.offset + alignment - 1) / alignment * alignment;
+		if (start + size > r.offset + r.size)
+			continue;
+
+		block.free.erase(block.free.begin() + i);
+		if (start + size < r.offset + r.size)
+			block.free.insert(block.free.begin() + i,
+					{start + size, r.offset + r.size - (start + size)});
+		if (start > r.offset)
+			block.free.insert(block.free.begin() + i, {r.offset, start - r.offset});
+		offset = start;
+		return true;
+	}
+	return false;
+}
+
+VkAllocator::Allocation VkAllocator::bindImage(VkImage image) {
+	VkMemoryRequirements reqs;
+	bool dedicated = false;
+	if (getRequirements2) {
+		VkMemoryDedicatedRequirementsKHR dedicatedReqs{};
+		dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+		VkMemoryRequirements2KHR reqs2{};
+		reqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+		reqs2.pNext = &dedicatedReqs;
+		VkImageMemoryRequirementsInfo2KHR info{};
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR;
+		info.image = image;
+		getRequirements2(device, &info, &reqs2);
+		reqs = reqs2.memoryRequirements;
+		// only when the driver insists. merely preferring it isn't worth a block per image
+		dedicated = dedicatedReqs.requiresDedicatedAllocation;
+	} else {
+		devFuncs->vkGetImageMemoryRequirements(device, image, &reqs);
+	}
+
+	int type = findMemoryType(reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (type == -1)
+		type = findMemoryType(reqs.memoryTypeBits, 0);
+	if (type == -1)
+		throw std::runtime_error("No memory type can hold the overlay image");
+
+	Allocation a;
+	a.size = reqs.size;
+	if (dedicated) {
+		a.memory = allocate(reqs.size, type, image);
+		stats.dedicated++;
+	} else {
+		bool found = false;
+		for (size_t i = 0; i < blocks.size() && !found; i++) {
+			if (blocks[i].memory == VK_NULL_HANDLE || blocks[i].type != uint32_t(type))
+				continue;
+			found = suballocate(blocks[i], reqs.size, reqs.alignment, a.offset);
+			if (found)
+				a.block = i;
+		}
+
+		if (!found) {
+			// an empty block that didn't fit is only in the way now
+			for (Block& old : blocks) {
+				if (old.memory != VK_NULL_HANDLE && old.type == uint32_t(type) && isEmpty(old)) {
+					devFuncs->vkFreeMemory(device, old.memory, nullptr);
+					stats.reserved -= old.size;
+					stats.blocks--;
+					old = Block{};
+				}
+			}
+
+			Block block;
+			block.size = std::max(blockSize, reqs.size);
+			block.type = type;
+			block.memory = allocate(block.size, type, VK_NULL_HANDLE);
+			block.free.push_back({0, block.size});
+			suballocate(block, reqs.size, reqs.alignment, a.offset);
+
+			// reuse the slot of a block that was given back
+			a.block = blocks.size();
+			for (size_t i = 0; i < blocks.size(); i++) {
+				if (blocks[i].memory == VK_NULL_HANDLE) {
+					a.block = i;
+					break;
+				}
+			}
+			if (a.block == int(blocks.size()))
+				blocks.push_back(std::move(block));
+			else
+				blocks[a.block] = std::move(block);
+			stats.blocks++;
+		}
+		a.memory = blocks[a.block].memory;
+	}
+	stats.used += a.size;
+
+	VkResult result = devFuncs->vkBindImageMemory(device, image, a.memory, a.offset);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to bind image memory (" + std::to_string(result) + ")");
+	return a;
+}
+
+void VkAllocator::free(Allocation& a) {
+	if (a.memory == VK_NULL_HANDLE)
+		return;
+	stats.used -= a.size;
+
+	if (a.block == -1) {
+		devFuncs->vkFreeMemory(device, a.memory, nullptr);
+		stats.reserved -= a.size;
+		stats.dedicated--;
+		a = Allocation{};
+		return;
+	}
+
+	// put the range back, merging it with its neighbours
+	Block& block = blocks[a.block];
+	auto it = block.free.begin();
+	while (it != block.free.end() && it->offset < a.offset)
+		it++;
+	it = block.free.insert(it, {a.offset, a.size});
+	if (it + 1 != block.free.end() && it->offset + it->size == (it + 1)->offset) {
+		it->size += (it + 1)->size;
+		block.free.erase(it + 1);
+	}
+	if (it != block.free.begin() && (it - 1)->offset + (it - 1)->size == it->offset) {
+		(it - 1)->size += it->size;
+		block.free.erase(it);
+	}
+	a = Allocation{};
+
+	// an empty block is kept while it's the only one of its type, the next resize needs it
+	if (!isEmpty(block))
+		return;
+	for (const Block& other : blocks) {
+		if (&other != &block && other.memory != VK_NULL_HANDLE && other.type == block.type) {
+			devFuncs->vkFreeMemory(device, block.memory, nullptr);
+			stats.reserved -= block.size;
+			stats.blocks--;
+			block = Block{};
+			return;
+		}
+	}
+}
+
+bool VkAllocator::isEmpty(const Block& block) {
+	return block.free.size() == 1 && block.free[0].size == block.size;
+}
+
+VkAllocator::Usage VkAllocator::usage() const { return stats; }
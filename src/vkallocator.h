@@ -0,0 +1,70 @@
+#ifndef VKALLOCATOR_H
+#define VKALLOCATOR_H
+
+#include <QVulkanInstance>
+#include <vector>
+// vkallocator.h: device memory for vrdio's own images. memory is taken from a few large blocks
+// and handed back to them when images are destroyed, so resizes reuse what's already there
+
+class VkAllocator {
+  public:
+	// part of a block, or a whole dedicated allocation
+	struct Allocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		int block = -1; // -1 for dedicated allocations
+	};
+
+	struct Usage {
+		VkDeviceSize reserved = 0; // allocated from the device, blocks and dedicated
+		VkDeviceSize used = 0;     // handed out to images
+		int blocks = 0;
+		int dedicated = 0;
+	};
+
+	// sub-allocating blocks are at least this large
+	static constexpr VkDeviceSize blockSize = 64ull << 20;
+
+	// dedicatedAllocation: VK_KHR_get_memory_requirements2 and VK_KHR_dedicated_allocation are
+	// enabled on device, so drivers can ask for images to get their own allocation
+	VkAllocator(QVulkanInstance* instance, VkPhysicalDevice physicalDevice, VkDevice device,
+			bool dedicatedAllocation);
+	~VkAllocator();
+	VkAllocator(const VkAllocator&) = delete;
+	VkAllocator& operator=(const VkAllocator&) = delete;
+
+	// allocates memory for image and binds it. device local memory is preferred, throws if no
+	// memory type the image supports can be allocated from
+	Allocation bindImage(VkImage image);
+	void free(Allocation& allocation);
+
+	Usage usage() const;
+
+  private:
+	struct Range {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t type = 0;
+		std::vector<Range> free; // sorted by offset, neighbours are always merged
+	};
+
+	QVulkanDeviceFunctions* devFuncs;
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memProps;
+	PFN_vkGetImageMemoryRequirements2KHR getRequirements2;
+	std::vector<Block> blocks;
+	Usage stats;
+
+	// first type allowed by typeBits that has all of the wanted flags, or -1
+	int findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags wanted) const;
+	VkDeviceMemory allocate(VkDeviceSize size, uint32_t type, VkImage dedicatedImage);
+	bool suballocate(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+	static bool isEmpty(const Block& block);
+};
+
+#endif // VKALLOCATOR_H
@@ -1,7 +1,9 @@
 #include "vrmanager.h"
 
 #include "openvr.h"
+#include "stats.h"
 #include "strs.h"
+#include "trace.h"
 
 #include <QDir>
 #include <QGuiApplication>
@@ -18,42 +20,195 @@
 #include <QTimer>
 #include <QVulkanFunctions>
 #include <QVulkanInstance>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <optional>
 using namespace vr;
 
+namespace {
+// the default 2100 unit wide layout is 2.7 m wide, other layout sizes keep the units that size
+constexpr float metersPerUnit = 2.7f / 2100;
+
+// the wrist overlay's layout, about as wide as a watch strap is long
+constexpr int wristWidth = 600;
+constexpr int wristHeight = 300;
+constexpr float wristMeters = 0.12f;
+
+// relative to the controller: a little behind the grip towards the wrist, tilted up to face
+// the user
+HmdMatrix34_t wristTransform(VRManager::Hand hand) {
+	const float tilt = qDegreesToRadians(-60.0f);
+	const float side = hand == VRManager::Hand::Left ? 0.02f : -0.02f;
+	return {{{1.0f, 0.0f, 0.0f, side},
+			{0.0f, std::cos(tilt), -std::sin(tilt), 0.03f},
+			{0.0f, std::sin(tilt), std::cos(tilt), 0.12f}}};
+}
+} // namespace
+
 VRManager::VRManager(QQuickView* w, QQuickRenderControl* rc)
-	: window(w), renderCtrl(rc), overlayWidth(2100), overlayHeight(1200) {
+	: commandPool(VK_NULL_HANDLE), wristHand(Hand::Left), icon(k_ulOverlayHandleInvalid),
+	  damageTracking(true) {
+	dashboard.window = w;
+	dashboard.renderCtrl = rc;
+	dashboard.metersPerUnit = metersPerUnit;
 
 	// expose overlay size to QML
-	window->engine()->rootContext()->setContextProperty("screenWidth", overlayWidth);
-	window->engine()->rootContext()->setContextProperty("screenHeight", overlayHeight);
+	updateSize(dashboard);
 
 	// signal to create scene graph
-	connect(window, SIGNAL(sceneGraphInitialized()), this, SLOT(prepareSceneGraph()));
+	connect(w, SIGNAL(sceneGraphInitialized()), this, SLOT(prepareSceneGraph()));
+
+	// track damage, so unchanged frames don't get rendered and resubmitted
+	connect(rc, SIGNAL(sceneChanged()), this, SLOT(markDirty()));
+	connect(rc, SIGNAL(renderRequested()), this, SLOT(markDirty()));
 
-	window->setVulkanInstance(&instance);
+	w->setVulkanInstance(&instance);
 
 	initVR();
 	initVulkan();
 	getPhysicalDevice();
 	createLogicalDevice();
+	createCommandPool();
 }
 
 void VRManager::prepareSceneGraph() {
-	createImage();
-	createCommandPool();
-	window->setRenderTarget(QQuickRenderTarget::fromVulkanImage(
-			image, curLayout, QSize(overlayWidth, overlayHeight)));
+	createImages(dashboard);
 
-	// create timer
+	// create timer. its interval follows the frame state, see setFrameState()
 	checkTimer = std::make_unique<QTimer>(this);
 	connect(checkTimer.get(), SIGNAL(timeout()), this, SLOT(checkRender()));
-	checkTimer->setInterval(20);
+	updateInterval();
 	checkTimer->start();
 }
 
+void VRManager::addWristOverlay(QQuickView* w, QQuickRenderControl* rc, Hand hand) {
+	wrist = std::make_unique<Surface>();
+	wrist->window = w;
+	wrist->renderCtrl = rc;
+	wrist->size.width = wristWidth;
+	wrist->size.height = wristHeight;
+	wrist->metersPerUnit = wristMeters / wristWidth;
+	wristHand = hand;
+	updateSize(*wrist);
+
+	connect(rc, SIGNAL(sceneChanged()), this, SLOT(markWristDirty()));
+	connect(rc, SIGNAL(renderRequested()), this, SLOT(markWristDirty()));
+
+	// same device, so both scenes end up on the one queue
+	w->setVulkanInstance(&instance);
+	w->setGraphicsDevice(
+			QQuickGraphicsDevice::fromDeviceObjects(physicalDevice, device, graphicsFamily));
+	createImages(*wrist);
+}
+
+void VRManager::setOverlaySize(const OverlaySize& s) {
+	OverlaySize& size = dashboard.size;
+	size = s;
+	size.width = std::max(1, size.width);
+	size.height = std::max(1, size.height);
+	size.scale = std::clamp(size.scale, minScale, maxScale);
+	updateSize(dashboard);
+}
+
+QSize VRManager::renderSize() const { return renderSize(dashboard); }
+
+QSize VRManager::renderSize(const Surface& s) {
+	return QSize(qCeil(s.size.width * s.size.scale), qCeil(s.size.height * s.size.scale));
+}
+
+void VRManager::updateSize(Surface& s) {
+	const OverlaySize& size = s.size;
+	s.window->engine()->rootContext()->setContextProperty("screenWidth", size.width);
+	s.window->engine()->rootContext()->setContextProperty("screenHeight", size.height);
+
+	// the layout stays in its own units, scaling the root item scales everything in it
+	if (QQuickItem* root = s.window->rootObject()) {
+		root->setTransformOrigin(QQuickItem::TopLeft);
+		root->setScale(size.scale);
+	}
+
+	// only reallocate if the rendered part doesn't fit, or the texture can't be cropped to it
+	const QSize pixels = renderSize(s);
+	if (s.images[0].image != VK_NULL_HANDLE) {
+		bool fits =
+				pixels.width() <= s.imageSize.width() && pixels.height() <= s.imageSize.height();
+		if (size.textureBounds ? !fits : pixels != s.imageSize) {
+			finishRendering();
+			destroyImages(s);
+			createImages(s);
+		}
+	}
+
+	if (s.overlay != k_ulOverlayHandleInvalid) {
+		QMutexLocker locker(&vrLock);
+		VROverlay()->SetOverlayWidthInMeters(s.overlay, s.metersPerUnit * size.width);
+
+		// SetOverlayMouseScale basically sets bounds of the overlay
+		HmdVector2_t mouseScale = {(float)pixels.width(), (float)pixels.height()};
+		VROverlay()->SetOverlayMouseScale(s.overlay, &mouseScale);
+
+		// vulkan textures have their origin at the top left, which is where the frame is rendered
+		VRTextureBounds_t bounds = {0.0f, 0.0f, 1.0f, 1.0f};
+		if (size.textureBounds && !s.imageSize.isEmpty()) {
+			bounds.uMax = float(pixels.width()) / s.imageSize.width();
+			bounds.vMax = float(pixels.height()) / s.imageSize.height();
+		}
+		VROverlay()->SetOverlayTextureBounds(s.overlay, &bounds);
+	}
+	s.dirty = true;
+}
+
+void VRManager::setFrameIntervals(const FrameIntervals& i) {
+	intervals = i;
+	updateInterval();
+}
+
+void VRManager::setFrameState(Surface& s, FrameState state) {
+	if (state == s.state)
+		return;
+
+	bool wasVisible = s.state != FrameState::Hidden;
+	s.state = state;
+	updateInterval();
+
+	if (&s == &dashboard && wasVisible != (state != FrameState::Hidden))
+		emit visibilityChanged(!wasVisible);
+}
+
+// one timer serves both overlays, so it runs at the rate of the busier one
+void VRManager::updateInterval() {
+	stats.state = dashboard.state;
+	if (wrist)
+		stats.state = std::max(stats.state, wrist->state);
+
+	switch (stats.state) {
+	case FrameState::Hidden:
+		stats.interval = intervals.hidden;
+		break;
+	case FrameState::Idle:
+		stats.interval = intervals.idle;
+		break;
+	case FrameState::Active:
+		stats.interval = intervals.active;
+		break;
+	}
+
+	if (checkTimer)
+		checkTimer->setInterval(stats.interval);
+}
+
+void VRManager::noteInput(Surface& s) {
+	s.lastInput.start();
+	setFrameState(s, FrameState::Active);
+}
+
 void VRManager::pollEvents() {
+	Stats::Timer timer(Stats::PollEvents);
+	Trace::Span span("pollEvents");
 	VREvent_t event{};
 	// quitting
 	while (VRSystem()->PollNextEvent(&event, sizeof(event))) {
@@ -63,91 +218,262 @@ void VRManager::pollEvents() {
 			std::cout << "Exiting!" << std::endl;
 			QGuiApplication::quit();
 		} break;
+		case VREvent_DashboardActivated: {
+			// our overlay might not be the one being shown
+			QMutexLocker locker(&vrLock);
+			bool visible = VROverlay()->IsOverlayVisible(dashboard.overlay);
+			locker.unlock();
+			if (visible && dashboard.state == FrameState::Hidden)
+				setFrameState(dashboard, FrameState::Idle);
+		} break;
+		case VREvent_DashboardDeactivated: {
+			setFrameState(dashboard, FrameState::Hidden);
+		} break;
+		case VREvent_TrackedDeviceActivated:
+		case VREvent_TrackedDeviceRoleChanged: {
+			// controllers come and go, and can swap hands
+			attachWrist();
+		} break;
 		default:
 			break;
 		}
 	}
 
-	// input
-	while (VROverlay()->PollNextOverlayEvent(overlay, &event, sizeof(event))) {
-		switch (event.eventType) {
+	pollOverlayEvents(dashboard);
+	if (wrist)
+		pollOverlayEvents(*wrist);
+}
 
-		case (VREvent_MouseMove): {
-			// SteamVR (0,0) is bottom left, while Qt (0,0) is top left - invert y
-			QPointF mousePos(event.data.mouse.x, overlayHeight - event.data.mouse.y);
-			QMouseEvent mouseEvent(QEvent::MouseMove, mousePos, window->mapToGlobal(mousePos),
-					Qt::NoButton, activeMouseButtons, Qt::NoModifier);
+void VRManager::pollOverlayEvents(Surface& s) {
+	VREvent_t event{};
+	// input, in texture pixels as set by SetOverlayMouseScale
+	const int height = renderSize(s).height();
+
+	// a laser pointer queues several moves per tick, and each one is a hit test and a round of
+	// QML handlers. a run of moves is sent as its last one and a run of scrolls as their sum,
+	// anything else sends what's pending first so presses and releases keep their order
+	std::optional<QPointF> move;
+	float scroll = 0;
+	auto flushMove = [&] {
+		if (move)
+			sendMouseEvent(s, QEvent::MouseMove, *move, Qt::NoButton);
+		move.reset();
+	};
+	auto flushScroll = [&] {
+		if (scroll != 0)
+			sendScroll(s, scroll);
+		scroll = 0;
+	};
+
+	while (nextOverlayEvent(s, event)) {
+		switch (event.eventType) {
 
-			QGuiApplication::sendEvent(window, &mouseEvent);
-			lastPos = mousePos;
+		case (VREvent_OverlayShown): {
+			if (s.state == FrameState::Hidden)
+				setFrameState(s, FrameState::Idle);
 		} break;
 
-		case (VREvent_MouseButtonDown): {
-			QPointF mousePos(event.data.mouse.x, overlayHeight - event.data.mouse.y);
-			activeMouseButtons |= Qt::LeftButton;
-
-			QMouseEvent mouseEvent(QEvent::MouseButtonPress, mousePos,
-					window->mapToGlobal(mousePos), Qt::LeftButton, activeMouseButtons,
-					Qt::NoModifier);
+		case (VREvent_OverlayHidden): {
+			setFrameState(s, FrameState::Hidden);
+		} break;
 
-			QGuiApplication::sendEvent(window, &mouseEvent);
-			lastPos = mousePos;
+		case (VREvent_MouseMove): {
+			noteInput(s);
+			stats.inputEvents++;
+			// the pending scroll happened where the pointer was before this move
+			flushScroll();
+			// SteamVR (0,0) is bottom left, while Qt (0,0) is top left - invert y
+			move = QPointF(event.data.mouse.x, height - event.data.mouse.y);
 		} break;
 
+		case (VREvent_MouseButtonDown):
 		case (VREvent_MouseButtonUp): {
-			QPointF mousePos(event.data.mouse.x, overlayHeight - event.data.mouse.y);
-			activeMouseButtons &= ~Qt::LeftButton;
-
-			QMouseEvent mouseEvent(QEvent::MouseButtonRelease, mousePos,
-					window->mapToGlobal(mousePos), Qt::LeftButton, activeMouseButtons,
-					Qt::NoModifier);
-
-			QGuiApplication::sendEvent(window, &mouseEvent);
-			lastPos = mousePos;
+			noteInput(s);
+			stats.inputEvents++;
+			flushMove();
+			flushScroll();
+			QPointF mousePos(event.data.mouse.x, height - event.data.mouse.y);
+			bool down = event.eventType == VREvent_MouseButtonDown;
+			if (down)
+				s.activeMouseButtons |= Qt::LeftButton;
+			else
+				s.activeMouseButtons &= ~Qt::LeftButton;
+			sendMouseEvent(s, down ? QEvent::MouseButtonPress : QEvent::MouseButtonRelease,
+					mousePos, Qt::LeftButton);
 		} break;
 
 		case (VREvent_ScrollDiscrete): {
-			QPoint scrollData(0, -event.data.scroll.ydelta);
-			QWheelEvent wheelEvent(lastPos, window->mapToGlobal(lastPos), QPoint(), scrollData,
-					activeMouseButtons, Qt::NoModifier, Qt::NoScrollPhase, false,
-					Qt::MouseEventNotSynthesized);
-			QGuiApplication::sendEvent(window, &wheelEvent);
-
+			noteInput(s);
+			stats.inputEvents++;
+			flushMove();
+			scroll += event.data.scroll.ydelta;
 		} break;
 		}
 	}
+
+	flushMove();
+	flushScroll();
+}
+
+bool VRManager::nextOverlayEvent(Surface& s, VREvent_t& event) {
+	QMutexLocker locker(&vrLock);
+	return VROverlay()->PollNextOverlayEvent(s.overlay, &event, sizeof(event));
+}
+
+void VRManager::sendMouseEvent(Surface& s, QEvent::Type type, QPointF pos, Qt::MouseButton button) {
+	QMouseEvent mouseEvent(type, pos, s.window->mapToGlobal(pos), button, s.activeMouseButtons,
+			Qt::NoModifier);
+	QGuiApplication::sendEvent(s.window, &mouseEvent);
+	s.lastPos = pos;
+	stats.inputDispatched++;
+}
+
+void VRManager::sendScroll(Surface& s, float ydelta) {
+	QPoint scrollData(0, -ydelta);
+	QWheelEvent wheelEvent(s.lastPos, s.window->mapToGlobal(s.lastPos), QPoint(), scrollData,
+			s.activeMouseButtons, Qt::NoModifier, Qt::NoScrollPhase, false,
+			Qt::MouseEventNotSynthesized);
+	QGuiApplication::sendEvent(s.window, &wheelEvent);
+	stats.inputDispatched++;
 }
 
 void VRManager::checkRender() {
+	Trace::Span span("checkRender");
 	// check if overlay is setup
-	if (!VROverlay() || overlay == k_ulOverlayHandleInvalid) {
-		VROverlay()->SetOverlayTexture(overlay, nullptr);
+	if (!VROverlay() || dashboard.overlay == k_ulOverlayHandleInvalid) {
+		VROverlay()->SetOverlayTexture(dashboard.overlay, nullptr);
 		return;
 	}
 
-	render();
+	// handle input first, it may dirty the scene for this frame
 	pollEvents();
+
+	for (Surface* s : {&dashboard, wrist.get()}) {
+		if (!s)
+			continue;
+
+		// drop back to the idle rate once the user stops interacting
+		if (s->state == FrameState::Active && s->lastInput.elapsed() > intervals.activeTimeout)
+			setFrameState(*s, FrameState::Idle);
+
+		// nothing to show: dirty scenes get rendered once the overlay is visible again
+		if (s->state == FrameState::Hidden)
+			continue;
+		// still on the render thread. it stays dirty, so the next tick picks it up
+		if (s->rendering)
+			continue;
+
+		if (damageTracking && !s->dirty) {
+			stats.skipped++;
+			continue;
+		}
+
+		render(*s);
+	}
+}
+
+void VRManager::markDirty() { dashboard.dirty = true; }
+
+void VRManager::markWristDirty() {
+	if (wrist)
+		wrist->dirty = true;
+}
+
+void VRManager::setDamageTracking(bool enabled) {
+	damageTracking = enabled;
+	dashboard.dirty = true;
+	if (wrist)
+		wrist->dirty = true;
+}
+
+const VRManager::FrameStats& VRManager::frameStats() const { return stats; }
+
+VkAllocator::Usage VRManager::memoryUsage() const {
+	return allocator ? allocator->usage() : VkAllocator::Usage{};
+}
+
+void VRManager::render(Surface& s) {
+	Stats::Timer timer(Stats::Render); // GUI thread time only, with a render thread
+	Trace::Span span("render");
+	// cleared before syncing, so changes made during this frame get picked up by the next one
+	s.dirty = false;
+	stats.rendered++;
+
+	Trace::Span phase("polishItems");
+	s.renderCtrl->polishItems();
+	if (!renderThread) {
+		phase.next("syncFrame");
+		syncFrame(s);
+		phase.next("renderFrame");
+		renderFrame(s);
+		return;
+	}
+
+	// QML can't change while the render thread syncs, so this thread waits for that part only
+	phase.next("waitForSync");
+	s.rendering = true;
+	QMutexLocker locker(&syncLock);
+	synced = false;
+	QMetaObject::invokeMethod(
+			renderer.get(),
+			[this, &s] {
+				{
+					QMutexLocker locker(&syncLock);
+					syncFrame(s);
+					synced = true;
+					syncDone.wakeOne();
+				}
+				renderFrame(s);
+				s.rendering = false;
+			},
+			Qt::QueuedConnection);
+	while (!synced)
+		syncDone.wait(&syncLock);
+}
+
+void VRManager::syncFrame(Surface& s) {
+	// the fence only covers our own work on this image, the transition submitted with its last
+	// frame, and waiting on it never waits for the rest of the queue. OpenVR has no way to tell
+	// when the compositor is done reading a texture. the rotation keeps both the image it shows
+	// and the one it was showing before out of reach, so a compositor frame that started just
+	// before the last SetOverlayTexture can still finish with its image. this is as far as the
+	// API allows, not a guarantee from SteamVR
+	OverlayImage& img = s.images[s.currentImage];
+	Trace::Span phase("waitForFence");
+	devFuncs->vkWaitForFences(device, 1, &img.fence, VK_TRUE, UINT64_MAX);
+	s.window->setRenderTarget(
+			QQuickRenderTarget::fromVulkanImage(img.image, img.layout, renderSize(s)));
+
+	phase.next("beginFrame");
+	s.renderCtrl->beginFrame();
+	phase.next("sync");
+	s.renderCtrl->sync();
 }
 
-void VRManager::render() {
-	renderCtrl->polishItems();
-	renderCtrl->beginFrame();
-	renderCtrl->sync();
+void VRManager::renderFrame(Surface& s) {
+	OverlayImage& img = s.images[s.currentImage];
+	QQuickRenderControl* renderCtrl = s.renderCtrl;
+	Trace::Span phase("renderCtrl.render");
 	renderCtrl->render();
+	phase.next("endFrame");
 	renderCtrl->endFrame();
-	curLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // QQuickRenderControl transitions image
+	phase.next("submit");
+	img.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // QQuickRenderControl transitions image
 
-	transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	QElapsedTimer submitTimer;
+	submitTimer.start();
+	QMutexLocker locker(&vrLock);
+	transitionImageLayout(img);
 
 	VRVulkanTextureData_t texData{};
-	texData.m_nImage = (uint64_t)image;
+	texData.m_nImage = (uint64_t)img.image;
 	texData.m_pDevice = device;
 	texData.m_pPhysicalDevice = physicalDevice;
 	texData.m_pInstance = instance.vkInstance();
 	texData.m_pQueue = graphicsQueue;
 	texData.m_nQueueFamilyIndex = graphicsFamily;
-	texData.m_nWidth = overlayWidth;
-	texData.m_nHeight = overlayHeight;
+	texData.m_nWidth = s.imageSize.width();
+	texData.m_nHeight = s.imageSize.height();
 	texData.m_nFormat = VK_FORMAT_R8G8B8A8_UNORM;
 	texData.m_nSampleCount = 1;
 
@@ -156,20 +482,61 @@ void VRManager::render() {
 	tex.eType = TextureType_Vulkan;
 	tex.eColorSpace = ColorSpace_Auto;
 
-	VROverlay()->SetOverlayTexture(overlay, &tex);
+	VROverlay()->SetOverlayTexture(s.overlay, &tex);
+	locker.unlock();
+	qint64 submitNs = submitTimer.nsecsElapsed();
+	if (renderThread)
+		QMetaObject::invokeMethod(
+				this, [this, submitNs] { stats.submitNs = submitNs; }, Qt::QueuedConnection);
+	else
+		stats.submitNs = submitNs;
+
+	s.currentImage = (s.currentImage + 1) % imageCount;
+}
+
+void VRManager::startRenderThread() {
+	if (renderThread)
+		return;
+	renderThread = std::make_unique<QThread>();
+	renderThread->setObjectName("vrdio-render");
+	renderer = std::make_unique<QObject>();
+	renderer->moveToThread(renderThread.get());
+	renderThread->start();
+}
+
+bool VRManager::initializeScene(QQuickRenderControl* rc) {
+	if (!renderThread)
+		return rc->initialize();
+
+	rc->prepareThread(renderThread.get());
+	bool initialized = false;
+	QMetaObject::invokeMethod(
+			renderer.get(), [rc, &initialized] { initialized = rc->initialize(); },
+			Qt::BlockingQueuedConnection);
+	// sceneGraphInitialized was emitted on the render thread. deliver it now, so the images
+	// exist before buildOverlay() like they do without the thread
+	QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+	return initialized;
+}
+
+void VRManager::finishRendering() {
+	if (renderThread)
+		QMetaObject::invokeMethod(renderer.get(), [] {}, Qt::BlockingQueuedConnection);
 }
+
 void VRManager::buildOverlay() {
 	VROverlay()->CreateDashboardOverlay(
-			strings::app_key, strings::overlay_friendly_name, &overlay, &icon);
-	VROverlay()->SetOverlayWidthInMeters(overlay, 2.7f);
-	VROverlay()->SetOverlayInputMethod(overlay, VROverlayInputMethod_Mouse);
-
-	// SetOverlayMouseScale basically sets bounds of the overlay
-	HmdVector2_t mouseScale = {(float)overlayWidth, (float)overlayHeight};
-	VROverlay()->SetOverlayMouseScale(overlay, &mouseScale);
+			strings::app_key, strings::overlay_friendly_name, &dashboard.overlay, &icon);
+	VROverlay()->SetOverlayInputMethod(dashboard.overlay, VROverlayInputMethod_Mouse);
+	// width, mouse scale and texture bounds
+	updateSize(dashboard);
 
 	// enable scroll events
-	VROverlay()->SetOverlayFlag(overlay, VROverlayFlags_SendVRDiscreteScrollEvents, true);
+	VROverlay()->SetOverlayFlag(
+			dashboard.overlay, VROverlayFlags_SendVRDiscreteScrollEvents, true);
+
+	if (VROverlay()->IsOverlayVisible(dashboard.overlay))
+		setFrameState(dashboard, FrameState::Idle);
 
 	// set up icon
 	if (temp_dir.isValid()) {
@@ -178,6 +545,36 @@ void VRManager::buildOverlay() {
 			VROverlay()->SetOverlayFromFile(icon, temp_file.toUtf8());
 		}
 	}
+
+	if (!wrist)
+		return;
+
+	VROverlay()->CreateOverlay(
+			strings::wrist_overlay_key, strings::wrist_overlay_friendly_name, &wrist->overlay);
+	VROverlay()->SetOverlayInputMethod(wrist->overlay, VROverlayInputMethod_Mouse);
+	// lets the laser pointer reach it while the dashboard is closed
+	VROverlay()->SetOverlayFlag(
+			wrist->overlay, VROverlayFlags_MakeOverlaysInteractiveIfVisible, true);
+	updateSize(*wrist);
+	attachWrist();
+	VROverlay()->ShowOverlay(wrist->overlay);
+	if (VROverlay()->IsOverlayVisible(wrist->overlay))
+		setFrameState(*wrist, FrameState::Idle);
+}
+
+void VRManager::attachWrist() {
+	if (!wrist || wrist->overlay == k_ulOverlayHandleInvalid)
+		return;
+
+	TrackedDeviceIndex_t controller = VRSystem()->GetTrackedDeviceIndexForControllerRole(
+			wristHand == Hand::Left ? TrackedControllerRole_LeftHand
+									: TrackedControllerRole_RightHand);
+	if (controller == k_unTrackedDeviceIndexInvalid)
+		return;
+
+	HmdMatrix34_t transform = wristTransform(wristHand);
+	QMutexLocker locker(&vrLock);
+	VROverlay()->SetOverlayTransformTrackedDeviceRelative(wrist->overlay, controller, &transform);
 }
 
 void VRManager::uninstall() { initVR(true); }
@@ -342,108 +739,132 @@ void VRManager::createLogicalDevice() {
 	vkFuncs->vkCreateDevice(physicalDevice, &createInfo, nullptr, &device);
 
 	devFuncs = instance.deviceFunctions(device);
+	// SteamVR usually asks for both of these anyway, they let the driver demand dedicated memory
+	auto enabled = [&reqExts_vk](const char* name) {
+		return std::any_of(reqExts_vk.begin(), reqExts_vk.end(),
+				[name](const char* ext) { return std::strcmp(ext, name) == 0; });
+	};
+	allocator = std::make_unique<VkAllocator>(&instance, physicalDevice, device,
+			enabled(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME)
+					&& enabled(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME));
+
 	// save graphics queue
 	devFuncs->vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
 
 	// set qgraphicsdevice
-	window->setGraphicsDevice(
+	dashboard.window->setGraphicsDevice(
 			QQuickGraphicsDevice::fromDeviceObjects(physicalDevice, device, graphicsFamily));
 }
 
-void VRManager::createImage() {
+void VRManager::createImages(Surface& s) {
+	// croppable textures are kept at least at scale 1, so switching back up is free
+	s.imageSize = renderSize(s);
+	if (s.size.textureBounds)
+		s.imageSize = s.imageSize.expandedTo(QSize(s.size.width, s.size.height));
+
+	for (auto& img : s.images) {
+		createImage(img, s.imageSize);
+		recordTransition(img);
+
+		// created signalled, so the first wait on a fresh image returns immediately
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		devFuncs->vkCreateFence(device, &fenceInfo, nullptr, &img.fence);
+	}
+	s.currentImage = 0;
+}
+
+void VRManager::destroyImages(Surface& s) {
+	// SteamVR must not keep showing an image that is about to be freed
+	if (s.overlay != k_ulOverlayHandleInvalid && s.images[0].image != VK_NULL_HANDLE) {
+		QMutexLocker locker(&vrLock);
+		VROverlay()->ClearOverlayTexture(s.overlay);
+	}
+	// only wait for our own submissions to finish, not everything else on the queue
+	for (auto& img : s.images) {
+		if (img.fence == VK_NULL_HANDLE)
+			continue;
+		devFuncs->vkWaitForFences(device, 1, &img.fence, VK_TRUE, UINT64_MAX);
+		devFuncs->vkDestroyFence(device, img.fence, nullptr);
+		devFuncs->vkFreeCommandBuffers(device, commandPool, 1, &img.transition);
+		devFuncs->vkDestroyImage(device, img.image, nullptr);
+		allocator->free(img.memory);
+		img = OverlayImage{};
+	}
+}
+
+void VRManager::createImage(OverlayImage& img, QSize size) {
 	// create vulkan image for rendering
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = overlayWidth;
-	imageInfo.extent.height = overlayHeight;
+	imageInfo.extent.width = size.width();
+	imageInfo.extent.height = size.height();
 	imageInfo.extent.depth = 1;
 	imageInfo.mipLevels = 1;
 	imageInfo.arrayLayers = 1;
 	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
 	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	curLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	img.layout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	devFuncs->vkCreateImage(device, &imageInfo, nullptr, &image);
-
-	// allocate memory for image
-	VkMemoryRequirements memReqs;
-	devFuncs->vkGetImageMemoryRequirements(device, image, &memReqs);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = UINT32_MAX;
-
-	VkPhysicalDeviceMemoryProperties memProps;
-	vkFuncs->vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
-	for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
-		if (memProps.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
-			allocInfo.memoryTypeIndex = i;
-			break;
-		}
-	}
-
-	if (allocInfo.memoryTypeIndex == UINT32_MAX)
-		exit(1);
+	devFuncs->vkCreateImage(device, &imageInfo, nullptr, &img.image);
 
-	devFuncs->vkAllocateMemory(device, &allocInfo, nullptr, &imageMem);
-
-	devFuncs->vkBindImageMemory(device, image, imageMem, 0);
+	img.memory = allocator->bindImage(img.image);
 }
 
-void VRManager::transitionImageLayout(VkImageLayout newLayout) {
-	if (newLayout == curLayout)
-		return; // no transition needed
+// QQuickRenderControl always leaves the image in COLOR_ATTACHMENT_OPTIMAL, and SteamVR wants
+// TRANSFER_SRC_OPTIMAL, so the same barrier is needed every frame: record it once per image
+void VRManager::recordTransition(OverlayImage& img) {
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+	devFuncs->vkAllocateCommandBuffers(device, &allocInfo, &img.transition);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	devFuncs->vkBeginCommandBuffer(img.transition, &beginInfo);
 
-	VkCommandBuffer cmdBuffer = beginSingleTimeCommands();
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = curLayout;
-	barrier.newLayout = newLayout;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
+	barrier.image = img.image;
 	barrier.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 			.baseMipLevel = 0,
 			.levelCount = 1,
 			.baseArrayLayer = 0,
 			.layerCount = 1};
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
-	VkPipelineStageFlags srcFlags, dstFlags;
-	if (curLayout == VK_IMAGE_LAYOUT_UNDEFINED
-			&& newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-		srcFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dstFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	} else if (curLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-			   && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
-		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-		srcFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dstFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	} else if (curLayout == VK_IMAGE_LAYOUT_UNDEFINED
-			   && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-		srcFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dstFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	} else {
-		throw std::runtime_error("Invalid layout transition!");
-	}
+	devFuncs->vkCmdPipelineBarrier(img.transition, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	devFuncs->vkEndCommandBuffer(img.transition);
+}
+
+// submits the pre-recorded transition after Qt's own submission. the image's fence signals
+// once it has executed, so nothing here waits on the queue
+void VRManager::transitionImageLayout(OverlayImage& img) {
+	Stats::Timer timer(Stats::Transition);
+	Trace::Span span("transitionImageLayout");
+	devFuncs->vkResetFences(device, 1, &img.fence);
 
-	devFuncs->vkCmdPipelineBarrier(
-			cmdBuffer, srcFlags, dstFlags, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &img.transition;
 
-	endSingleTimeCommands(cmdBuffer);
-	curLayout = newLayout;
+	devFuncs->vkQueueSubmit(graphicsQueue, 1, &submitInfo, img.fence);
+	img.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 }
 
 void VRManager::createCommandPool() {
@@ -454,42 +875,28 @@ void VRManager::createCommandPool() {
 	devFuncs->vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
 }
 
-VkCommandBuffer VRManager::beginSingleTimeCommands() {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = commandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-	devFuncs->vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	devFuncs->vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	return commandBuffer;
-}
-
-void VRManager::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-	devFuncs->vkEndCommandBuffer(commandBuffer);
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	devFuncs->vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	devFuncs->vkQueueWaitIdle(graphicsQueue);
-
-	devFuncs->vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
 VRManager::~VRManager() {
+	// the scene graphs were made on the render thread and go with it
+	if (renderThread) {
+		QMetaObject::invokeMethod(
+				renderer.get(),
+				[this] {
+					dashboard.renderCtrl->invalidate();
+					if (wrist)
+						wrist->renderCtrl->invalidate();
+				},
+				Qt::BlockingQueuedConnection);
+		renderThread->quit();
+		renderThread->wait();
+	}
+
+	destroyImages(dashboard);
+	if (wrist) {
+		destroyImages(*wrist);
+		if (wrist->overlay != k_ulOverlayHandleInvalid)
+			VROverlay()->DestroyOverlay(wrist->overlay);
+	}
 	devFuncs->vkDestroyCommandPool(device, commandPool, nullptr);
-	devFuncs->vkDestroyImage(device, image, nullptr);
-	devFuncs->vkFreeMemory(device, imageMem, nullptr);
+	allocator.reset();
 	VR_Shutdown();
 }
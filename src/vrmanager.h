@@ -2,25 +2,99 @@
 #define VRMANAGER_H
 
 #include "openvr.h"
+#include "vkallocator.h"
 
+#include <QElapsedTimer>
+#include <QMutex>
 #include <QObject>
 #include <QQuickGraphicsDevice>
 #include <QQuickView>
 #include <QTemporaryDir>
+#include <QThread>
 #include <QVulkanInstance>
+#include <QWaitCondition>
+#include <array>
+#include <atomic>
 #include <memory>
 
 class VRManager : public QObject {
 	Q_OBJECT
   public:
+	enum class FrameState {
+		Hidden, // overlay not visible: only poll for events
+		Idle,   // visible, but nobody is interacting with it
+		Active  // visible and receiving input
+	};
+
+	// timer intervals for each frame state, in milliseconds
+	struct FrameIntervals {
+		int hidden = 200;
+		int idle = 33;
+		int active = 11;
+		int activeTimeout = 1000; // time without input before going back to idle
+	};
+
+	struct FrameStats {
+		quint64 rendered = 0;
+		quint64 skipped = 0; // ticks where the scene was unchanged
+		FrameState state = FrameState::Hidden; // of whichever overlay is busiest
+		int interval = 0; // current tick interval in ms
+		qint64 submitNs = 0; // time spent handing the last frame to the GPU and SteamVR
+		quint64 inputEvents = 0;     // mouse and scroll events polled from the overlays
+		quint64 inputDispatched = 0; // what was left of them after coalescing, sent to QML
+	};
+
+	// size of the QML layout, exposed to it as screenWidth/screenHeight, and how many texture
+	// pixels each of its units gets
+	struct OverlaySize {
+		int width = 2100;
+		int height = 1200;
+		qreal scale = 1.0;
+		// keep the texture allocated at scale 1 and crop it to the rendered part with
+		// SetOverlayTextureBounds, so scales up to 1 can be switched to without reallocating
+		bool textureBounds = false;
+	};
+	static constexpr qreal minScale = 0.25;
+	static constexpr qreal maxScale = 2.0;
+
+	enum class Hand { Left, Right };
+
 	VRManager(QQuickView* window, QQuickRenderControl* rc);
 	~VRManager();
 	static void uninstall();
 	void buildOverlay();
+	// optional small overlay on the wrist of hand, shown outside of the dashboard too. window
+	// gets its own scene but shares the device, queue and command pool with the dashboard. call
+	// before window's render control is initialized, and buildOverlay() before it's shown
+	void addWristOverlay(QQuickView* window, QQuickRenderControl* rc, Hand hand);
+	// sync, render and submit on a thread of their own, so a busy GUI thread doesn't hold back
+	// frames. QML, input and polishing stay on the GUI thread, which only waits while the
+	// scene is synced. call before initializeScene()
+	void startRenderThread();
+	// rc->initialize(), on the render thread if there is one
+	bool initializeScene(QQuickRenderControl* rc);
+
+	// when enabled (the default), frames are only rendered and submitted if the scene changed
+	void setDamageTracking(bool enabled);
+	void setFrameIntervals(const FrameIntervals& intervals);
+	// can be changed at any time, the QML layout follows screenWidth/screenHeight
+	void setOverlaySize(const OverlaySize& size);
+	// texture pixels actually rendered each frame
+	QSize renderSize() const;
+	const FrameStats& frameStats() const;
+	// device memory held for the overlay images
+	VkAllocator::Usage memoryUsage() const;
 
   public slots:
 	void prepareSceneGraph();
 	void checkRender();
+	void markDirty();
+	void markWristDirty();
+
+  signals:
+	// the dashboard overlay was shown or hidden, for anything that should only run while it can
+	// be seen
+	void visibilityChanged(bool visible);
 
   private:
 	// initialization
@@ -28,43 +102,108 @@ class VRManager : public QObject {
 	void initVulkan();
 	void getPhysicalDevice();
 	void createLogicalDevice();
-	void createImage();
+
+	// one of the images the overlay gets rendered into. SteamVR says nothing about when it is
+	// done reading a texture, so an image is only rendered into again once two newer ones have
+	// replaced it, see syncFrame()
+	struct OverlayImage {
+		VkImage image = VK_NULL_HANDLE;
+		VkAllocator::Allocation memory;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkCommandBuffer transition = VK_NULL_HANDLE; // pre-recorded, see recordTransition()
+		VkFence fence = VK_NULL_HANDLE; // signalled once the image's last submit has executed
+	};
+	static constexpr int imageCount = 3;
+	static_assert(imageCount >= 3, "the image SteamVR shows and the one before stay untouched");
+
+	// a QML scene and the overlay showing it. everything vulkan except the images is shared
+	struct Surface {
+		QQuickView* window = nullptr;
+		QQuickRenderControl* renderCtrl = nullptr;
+		vr::VROverlayHandle_t overlay = vr::k_ulOverlayHandleInvalid;
+		OverlaySize size;
+		float metersPerUnit = 0;
+		QSize imageSize; // of the allocated images, can be larger than renderSize()
+		std::array<OverlayImage, imageCount> images;
+		int currentImage = 0;
+		bool dirty = true;
+		FrameState state = FrameState::Hidden;
+		QElapsedTimer lastInput;
+		Qt::MouseButtons activeMouseButtons;
+		QPointF lastPos;
+		// a frame is on the render thread, the next one waits for it
+		std::atomic<bool> rendering{false};
+	};
+
+	static QSize renderSize(const Surface& s);
+	void createImages(Surface& s);
+	void createImage(OverlayImage& img, QSize size);
+	void recordTransition(OverlayImage& img);
+	void destroyImages(Surface& s);
+	// applies the surface's size to whatever exists so far: QML, images and the overlay
+	void updateSize(Surface& s);
 
 	// rendering
 	void createCommandPool();
-	VkCommandBuffer beginSingleTimeCommands();
-	void endSingleTimeCommands(VkCommandBuffer b);
-	void transitionImageLayout(VkImageLayout newLayout);
-	void render();
+	void transitionImageLayout(OverlayImage& img);
+	void render(Surface& s);
+	// the parts of render() that can run on the render thread. syncFrame() must have the GUI
+	// thread waiting
+	void syncFrame(Surface& s);
+	void renderFrame(Surface& s);
+	// waits until the render thread is done with everything queued to it so far
+	void finishRendering();
 
 	void pollEvents();
+	void pollOverlayEvents(Surface& s);
+	// PollNextOverlayEvent under vrLock, which isn't held while the event is handled
+	bool nextOverlayEvent(Surface& s, vr::VREvent_t& event);
+	void sendMouseEvent(Surface& s, QEvent::Type type, QPointF pos, Qt::MouseButton button);
+	void sendScroll(Surface& s, float ydelta);
+	// points the wrist overlay at the current controller of wristHand, if there is one
+	void attachWrist();
+	void setFrameState(Surface& s, FrameState state);
+	void updateInterval();
+	void noteInput(Surface& s);
 
 	QTemporaryDir temp_dir; // for icon
 
-	QQuickView* window;
-	QQuickRenderControl* renderCtrl;
 	QVulkanInstance instance;
 	QVulkanFunctions* vkFuncs;
 
 	VkPhysicalDevice physicalDevice;
 	VkDevice device;
 
+	// with a render thread, the queue belongs to it: Qt submits its frames there and so does
+	// transitionImageLayout(). SteamVR may use it inside IVROverlay calls too, see vrLock
 	VkQueue graphicsQueue;
 	QVulkanDeviceFunctions* devFuncs;
 	uint32_t graphicsFamily;
-
-	VkImage image;
-	VkImageLayout curLayout;
-	VkDeviceMemory imageMem;
+	std::unique_ptr<VkAllocator> allocator;
 
 	VkCommandPool commandPool;
 
-	vr::VROverlayHandle_t overlay, icon;
-	int overlayWidth, overlayHeight;
+	// only with startRenderThread(). frames are queued to renderer, which lives on the thread
+	std::unique_ptr<QThread> renderThread;
+	std::unique_ptr<QObject> renderer;
+	QMutex syncLock;
+	QWaitCondition syncDone;
+	bool synced = false;
+	// IVROverlay isn't thread safe. held by the render thread while it submits and hands a frame
+	// to SteamVR, and by the GUI thread around its overlay calls once frames are rendered.
+	// buildOverlay() runs before that, the destructor after the thread is gone
+	QMutex vrLock;
+
+	Surface dashboard;
+	std::unique_ptr<Surface> wrist;
+	Hand wristHand;
+	vr::VROverlayHandle_t icon;
 	std::unique_ptr<QTimer> checkTimer;
 
-	Qt::MouseButtons activeMouseButtons;
-	QPointF lastPos;
+	bool damageTracking;
+	FrameStats stats;
+
+	FrameIntervals intervals;
 };
 
 #endif // VRMANAGER_H